@@ -0,0 +1,473 @@
+/* Benchmarks for the engine in cricket_simulator.c, built as a program of
+   their own so the game binary carries none of it:
+
+       gcc -std=c99 -O2 -pthread bench/cricket_bench.c -o cricket_bench -lm
+       ./cricket_bench --save bench/baseline.txt     # on the reference build
+       ./cricket_bench --baseline bench/baseline.txt # after a change
+
+   Every benchmark plays from a fixed seed and runs warmup rounds before
+   anything is timed. Latencies are per item (a ball, a match, a frame, a
+   lookup); the median is what the baseline compares, p99 shows the tail.
+   Files are written to a fresh temporary directory, never the working one. */
+#define CRICMANIA_NO_MAIN
+#include "../cricket_simulator.c"
+
+#ifdef _WIN32
+    #include <direct.h>
+    #define chdir _chdir
+    #define rmdir _rmdir
+#endif
+
+#define BENCH_SEED 20250601ULL
+#define BENCH_OVERS 20
+#define BENCH_SAMPLES 31
+#define BENCH_WARMUP 3
+#define BENCH_USERS 1000000
+#define BENCH_THRESHOLD 10.0
+#define BENCH_MAX_RESULTS 64
+#define BENCH_BALLS 100000
+#define BENCH_MATCHES 200
+#define BENCH_FRAMES 200
+#define BENCH_LOOKUPS 10000
+#define BENCH_BATCH_MATCHES 20000
+
+typedef struct {
+    char name[32];
+    const char* unit;
+    double median_ns;
+    double p99_ns;
+    double rate;
+} BenchResult;
+
+typedef struct {
+    int samples;
+    int warmup;
+    long users;
+    int threads;
+    uint64_t seed;
+    const char* only;
+    BenchResult results[BENCH_MAX_RESULTS];
+    int result_count;
+} Bench;
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Nearest-rank quantile of sorted values. */
+static double quantile(const double* sorted, int n, double q) {
+    int rank = (int)ceil(q * n) - 1;
+    if (rank < 0) rank = 0;
+    if (rank >= n) rank = n - 1;
+    return sorted[rank];
+}
+
+/* Records a benchmark from per-item times in nanoseconds. */
+static void bench_report(Bench* b, const char* name, const char* unit, double* ns, int n) {
+    BenchResult* r = &b->results[b->result_count++];
+
+    qsort(ns, n, sizeof(double), compare_double);
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->unit = unit;
+    r->median_ns = quantile(ns, n, 0.5);
+    r->p99_ns = quantile(ns, n, 0.99);
+    r->rate = r->median_ns > 0.0 ? 1e9 / r->median_ns : 0.0;
+    printf("%-22s %12.1f %12.1f %14.0f %s/s\n", r->name, r->median_ns, r->p99_ns, r->rate, unit);
+    fflush(stdout);
+}
+
+static int bench_wanted(const Bench* b, const char* name) {
+    return b->only == NULL || strstr(name, b->only) != NULL;
+}
+
+static double* bench_times(int n) {
+    double* ns = (double*)malloc(n * sizeof(double));
+    if (!ns) {
+        fprintf(stderr, "OUT OF MEMORY\n");
+        exit(1);
+    }
+    return ns;
+}
+
+/* play_ball() throughput: each sample is BENCH_BALLS balls, starting a
+   new match whenever one ends. */
+static void bench_ball(Bench* b, const MatchState* base) {
+    MatchState m = *base;
+    BallResult result;
+    double* ns = bench_times(b->samples);
+    long stream = 0;
+
+    m.match_over = 1;
+    for (int s = -b->warmup; s < b->samples; s++) {
+        double start = now_seconds();
+        for (long i = 0; i < BENCH_BALLS; i++) {
+            if (m.match_over) {
+                reset_match_state(&m);
+                rng_stream(&m.rng, b->seed, (uint64_t)stream++);
+                m.currently_batting = (int)(rng_next(&m.rng) >> 63);
+            }
+            if (play_ball(&m, &result) <= 0) m.match_over = 1;
+        }
+        double elapsed = now_seconds() - start;
+        if (s >= 0) ns[s] = elapsed * 1e9 / BENCH_BALLS;
+    }
+    bench_report(b, "ball", "ball", ns, b->samples);
+    free(ns);
+}
+
+/* Whole matches from the first ball to the result, each timed alone. */
+static void bench_match(Bench* b, const MatchState* base) {
+    MatchState m = *base;
+    BatchStats stats;
+    int n = b->samples * BENCH_MATCHES;
+    double* ns = bench_times(n);
+
+    memset(&stats, 0, sizeof(stats));
+    for (long i = -(long)b->warmup * BENCH_MATCHES; i < n; i++) {
+        double start = now_seconds();
+        run_batch(&m, i + b->warmup * BENCH_MATCHES, 1, b->seed, &stats, NULL);
+        double elapsed = now_seconds() - start;
+        if (i >= 0) ns[i] = elapsed * 1e9;
+    }
+    bench_report(b, "match", "match", ns, n);
+    free(ns);
+}
+
+/* One scoreboard frame of a match in its second innings, the longest
+   board there is. Presenting is left out: it is bound by the terminal. */
+static void bench_render(Bench* b, const MatchState* base) {
+    static Screen s;
+    MatchState m = *base;
+    BallResult result;
+    int n = b->samples * BENCH_FRAMES;
+    double* ns = bench_times(n);
+
+    reset_match_state(&m);
+    rng_stream(&m.rng, b->seed, 0);
+    while (m.first_innings && play_ball(&m, &result) > 0) {}
+    for (int i = 0; i < 30 && !m.match_over; i++) play_ball(&m, &result);
+
+    for (long i = -(long)b->warmup * BENCH_FRAMES; i < n; i++) {
+        double start = now_seconds();
+        render_scoreboard(&s, &m);
+        double elapsed = now_seconds() - start;
+        if (i >= 0) ns[i] = elapsed * 1e9;
+    }
+    bench_report(b, "render", "frame", ns, n);
+    free(ns);
+}
+
+/* Appending a finished match to the history: its balls, the index entry
+   and the hand-off to the log's writer thread, which is what
+   save_match_history() does. The match is played before the clock
+   starts; p99 includes waits for a full ring. */
+static void bench_history(Bench* b, const MatchState* base) {
+    static BallResult balls[2 * BENCH_OVERS * 6];
+    static int innings[2 * BENCH_OVERS * 6], ball_number[2 * BENCH_OVERS * 6];
+    EventLog log;
+    LogBlock block;
+    MatchState m = *base;
+    int n = b->samples * BENCH_MATCHES;
+    double* ns = bench_times(n);
+
+    if (!event_log_open(&log, "bench") || !log_block_init(&block, &log, BENCH_OVERS)) {
+        fprintf(stderr, "CANNOT OPEN EVENT LOG IN THE BENCH DIRECTORY\n");
+        exit(1);
+    }
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        block.roster[t] = event_log_roster(&log, &base->teams[t]);
+    }
+
+    for (long i = -(long)b->warmup * BENCH_MATCHES; i < n; i++) {
+        int count = 0;
+        reset_match_state(&m);
+        rng_stream(&m.rng, b->seed, (uint64_t)(i + b->warmup * BENCH_MATCHES));
+        m.currently_batting = (int)(rng_next(&m.rng) >> 63);
+        MatchState start_state = m;
+        while (!m.match_over) {
+            int batting = m.currently_batting;
+            innings[count] = m.first_innings ? 1 : 2;
+            if (play_ball(&m, &balls[count]) <= 0) break;
+            ball_number[count++] = m.teams[batting].total_balls;
+        }
+
+        double start = now_seconds();
+        log_begin_match(&block, log.next_match, &start_state);
+        for (int k = 0; k < count; k++) log_ball(&block, innings[k], ball_number[k], &balls[k]);
+        log_end_match(&block, &m);
+        int ok = log_block_flush(&block);
+        double elapsed = now_seconds() - start;
+        if (!ok) {
+            fprintf(stderr, "EVENT LOG WRITE FAILED\n");
+            exit(1);
+        }
+        log.next_match++;
+        if (i >= 0) ns[i] = elapsed * 1e9;
+    }
+    log_block_free(&block);
+    event_log_close(&log);
+    remove("bench.bin");
+    remove("bench.idx");
+    remove("bench.rosters");
+    bench_report(b, "history_append", "match", ns, n);
+    free(ns);
+}
+
+static void bench_username(char* out, long i) {
+    snprintf(out, MAX_USERNAME, "player%07ld", i);
+}
+
+/* Logins against a store of b->users accounts. The accounts file is
+   written in one go; opening it builds the index, which is timed once
+   as user_index_build. Half the lookups are for names that do not
+   exist, which walk a whole probe run. */
+static void bench_users(Bench* b) {
+    UserFileHeader header = {USER_MAGIC, USER_FILE_VERSION, (uint32_t)sizeof(User), 0};
+    UserStore store;
+    User user;
+    Rng rng;
+    char name[MAX_USERNAME];
+    double* ns = bench_times(b->samples);
+
+    FILE* f = fopen(USER_FILE, "wb");
+    if (!f || fwrite(&header, sizeof(header), 1, f) != 1) {
+        fprintf(stderr, "CANNOT WRITE %s\n", USER_FILE);
+        exit(1);
+    }
+    memset(&user, 0, sizeof(user));
+    memset(user.password_hash, 'a', 64);
+    for (long i = 0; i < b->users; i++) {
+        bench_username(user.username, i);
+        user.team_index = (int)(i & 1);
+        fwrite(&user, sizeof(user), 1, f);
+    }
+    if (fclose(f) != 0) {
+        fprintf(stderr, "CANNOT WRITE %s\n", USER_FILE);
+        exit(1);
+    }
+
+    double start = now_seconds();
+    int opened = user_store_open(&store);
+    double build = (now_seconds() - start) * 1e9;
+    if (!opened) {
+        fprintf(stderr, "CANNOT OPEN THE USER STORE\n");
+        exit(1);
+    }
+    bench_report(b, "user_index_build", "store", &build, 1);
+
+    rng_seed(&rng, b->seed);
+    for (int s = -b->warmup; s < b->samples; s++) {
+        long found = 0;
+        start = now_seconds();
+        for (int i = 0; i < BENCH_LOOKUPS; i++) {
+            long wanted = (long)rng_below(&rng, (uint32_t)(rng_next(&rng) >> 32), (uint32_t)b->users);
+            bench_username(name, i & 1 ? wanted + b->users : wanted);
+            found += user_store_find(&store, name, &user) >= 0;
+        }
+        double elapsed = now_seconds() - start;
+        if (found != BENCH_LOOKUPS / 2) {
+            fprintf(stderr, "USER LOOKUP FOUND %ld OF %d ACCOUNTS\n", found, BENCH_LOOKUPS / 2);
+            exit(1);
+        }
+        if (s >= 0) ns[s] = elapsed * 1e9 / BENCH_LOOKUPS;
+    }
+    user_store_close(&store);
+    remove(USER_FILE);
+    remove(USER_INDEX_FILE);
+    bench_report(b, "user_lookup", "lookup", ns, b->samples);
+    free(ns);
+}
+
+/* run_parallel_batch() on 1, 2, 4 ... b->threads workers with each kernel,
+   reported per ball so the two kernels read on the same scale. */
+static void bench_batch(Bench* b, const MatchState* base, BatchKernel kernel, const char* kernel_name) {
+    int samples = b->samples < 5 ? b->samples : 5;
+    double* ns = bench_times(samples);
+
+    for (int n = 1; ; n = n * 2 < b->threads ? n * 2 : b->threads) {
+        char name[32];
+        snprintf(name, sizeof(name), "batch_%s_t%d", kernel_name, n);
+        if (bench_wanted(b, name)) {
+            ThreadPool* pool = pool_create(n);
+            if (!pool) {
+                fprintf(stderr, "CANNOT START THREAD POOL\n");
+                exit(1);
+            }
+            for (int s = -1; s < samples; s++) {
+                BatchStats stats;
+                memset(&stats, 0, sizeof(stats));
+                double start = now_seconds();
+                run_parallel_batch(pool, base, BENCH_BATCH_MATCHES, b->seed, kernel, &stats, NULL);
+                double elapsed = now_seconds() - start;
+                if (s >= 0) ns[s] = stats.balls > 0 ? elapsed * 1e9 / stats.balls : 0.0;
+            }
+            pool_destroy(pool);
+            bench_report(b, name, "ball", ns, samples);
+        }
+        if (n >= b->threads) break;
+    }
+    free(ns);
+}
+
+static int save_baseline(const Bench* b, FILE* out) {
+    fprintf(out, "# cricket_bench baseline: name median_ns p99_ns\n");
+    for (int i = 0; i < b->result_count; i++) {
+        fprintf(out, "%s %.3f %.3f\n", b->results[i].name, b->results[i].median_ns, b->results[i].p99_ns);
+    }
+    return fclose(out) == 0;
+}
+
+/* Compares medians with the baseline; a benchmark more than threshold
+   percent slower is a regression. Benchmarks only one side has (say a
+   thread count this machine lacks) are skipped. */
+static int compare_baseline(const Bench* b, FILE* in, double threshold) {
+    char line[256], name[64];
+    double median, p99;
+    int regressions = 0;
+
+    printf("\n%-22s %12s %12s %9s\n", "VS BASELINE", "BASE ns", "NOW ns", "CHANGE");
+    while (fgets(line, sizeof(line), in)) {
+        if (line[0] == '#' || sscanf(line, "%63s %lf %lf", name, &median, &p99) != 3) continue;
+        for (int i = 0; i < b->result_count; i++) {
+            const BenchResult* r = &b->results[i];
+            if (strcmp(r->name, name) != 0 || median <= 0.0) continue;
+            double change = 100.0 * (r->median_ns - median) / median;
+            int slower = change > threshold;
+            regressions += slower;
+            printf("%s%-22s %12.1f %12.1f %+8.1f%%%s" RESET "\n", slower ? RED : change < -threshold ? GREEN : "",
+                   name, median, r->median_ns, change, slower ? "  REGRESSION" : "");
+        }
+    }
+    fclose(in);
+
+    if (regressions > 0) {
+        printf(RED "%d BENCHMARK%s SLOWER THAN THE BASELINE BY MORE THAN %.1f%%" RESET "\n",
+               regressions, regressions == 1 ? "" : "S", threshold);
+        return 0;
+    }
+    printf(GREEN "NO REGRESSIONS BEYOND %.1f%%" RESET "\n", threshold);
+    return 1;
+}
+
+static void print_bench_usage(const char* prog) {
+    fprintf(stderr,
+            "USAGE: %s [OPTIONS]\n"
+            "  --samples N      timed samples per benchmark (default %d)\n"
+            "  --warmup N       untimed samples first (default %d)\n"
+            "  --users N        accounts in the user store (default %d)\n"
+            "  --threads N      most workers for the batch benchmarks (default: all %d cores)\n"
+            "  --seed N         seed for every benchmark (default %llu)\n"
+            "  --only NAME      run only benchmarks whose name contains NAME\n"
+            "  --save FILE      write the results as a baseline\n"
+            "  --baseline FILE  compare with a saved baseline; exit 1 on a regression\n"
+            "  --threshold P    percent slower that counts as a regression (default %.0f)\n"
+            "Benchmarks: ball, match, render, history_append, user_index_build,\n"
+            "user_lookup, batch_scalar_tN, batch_lockstep_tN.\n",
+            prog, BENCH_SAMPLES, BENCH_WARMUP, BENCH_USERS, cpu_count(),
+            (unsigned long long)BENCH_SEED, BENCH_THRESHOLD);
+}
+
+int main(int argc, char** argv) {
+    static Bench b;
+    char work_dir[] = "cricket_bench.XXXXXX";
+    const char* save_path = NULL;
+    const char* baseline_path = NULL;
+    double threshold = BENCH_THRESHOLD;
+
+    b.samples = BENCH_SAMPLES;
+    b.warmup = BENCH_WARMUP;
+    b.users = BENCH_USERS;
+    b.threads = cpu_count();
+    b.seed = BENCH_SEED;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            print_bench_usage(argv[0]);
+            return 0;
+        }
+        if (value == NULL) {
+            print_bench_usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "--samples") == 0) {
+            b.samples = atoi(value);
+        } else if (strcmp(arg, "--warmup") == 0) {
+            b.warmup = atoi(value);
+        } else if (strcmp(arg, "--users") == 0) {
+            b.users = atol(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            b.threads = atoi(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            b.seed = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--only") == 0) {
+            b.only = value;
+        } else if (strcmp(arg, "--save") == 0) {
+            save_path = value;
+        } else if (strcmp(arg, "--baseline") == 0) {
+            baseline_path = value;
+        } else if (strcmp(arg, "--threshold") == 0) {
+            threshold = atof(value);
+        } else {
+            print_bench_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (b.samples < 1 || b.warmup < 0 || b.users < 1 || b.users > 100000000 || b.threads < 1) {
+        print_bench_usage(argv[0]);
+        return 1;
+    }
+    if (b.threads > MAX_THREADS) b.threads = MAX_THREADS;
+
+    /* Both files are opened before moving into the scratch directory, so
+       relative paths mean what the caller meant. */
+    FILE* save_file = NULL;
+    FILE* baseline_file = NULL;
+    if (baseline_path && !(baseline_file = fopen(baseline_path, "r"))) {
+        fprintf(stderr, "CANNOT READ BASELINE: %s\n", baseline_path);
+        return 1;
+    }
+    if (save_path && !(save_file = fopen(save_path, "w"))) {
+        fprintf(stderr, "CANNOT WRITE BASELINE: %s\n", save_path);
+        return 1;
+    }
+#ifdef _WIN32
+    if (_mkdir(work_dir) != 0 || chdir(work_dir) != 0) {
+#else
+    if (!mkdtemp(work_dir) || chdir(work_dir) != 0) {
+#endif
+        fprintf(stderr, "CANNOT CREATE A SCRATCH DIRECTORY\n");
+        return 1;
+    }
+
+    stats_init();
+    config.max_overs = BENCH_OVERS;
+    default_roster(&teams[0], "OMOR EKUSHEY HALL");
+    default_roster(&teams[1], "SHAHID SMRITY HALL");
+    match_init(&match, teams, &config);
+
+    printf("SEED %llu  SAMPLES %d  WARMUP %d  OVERS %d\n",
+           (unsigned long long)b.seed, b.samples, b.warmup, BENCH_OVERS);
+    printf("%-22s %12s %12s %16s\n", "BENCHMARK", "MEDIAN ns", "P99 ns", "RATE");
+
+    if (bench_wanted(&b, "ball")) bench_ball(&b, &match);
+    if (bench_wanted(&b, "match")) bench_match(&b, &match);
+    if (bench_wanted(&b, "render")) bench_render(&b, &match);
+    if (bench_wanted(&b, "history_append")) bench_history(&b, &match);
+    if (bench_wanted(&b, "user_index_build") || bench_wanted(&b, "user_lookup")) bench_users(&b);
+    bench_batch(&b, &match, KERNEL_SCALAR, "scalar");
+    bench_batch(&b, &match, KERNEL_LOCKSTEP, "lockstep");
+
+    if (chdir("..") == 0) rmdir(work_dir);
+
+    int ok = 1;
+    if (save_file) {
+        ok = save_baseline(&b, save_file);
+        if (!ok) fprintf(stderr, "CANNOT WRITE BASELINE: %s\n", save_path);
+    }
+    if (baseline_file && !compare_baseline(&b, baseline_file, threshold)) ok = 0;
+    return ok ? 0 : 1;
+}
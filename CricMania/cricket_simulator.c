@@ -1,14 +1,36 @@
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdarg.h>
 #include <string.h>
+#include <math.h>
 #include <time.h>
+#include <signal.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
 
 #ifdef _WIN32
     #include <windows.h>
     #include <conio.h>
+    #include <io.h>
 #else
     #include <termios.h>
     #include <unistd.h>
+    #include <pthread.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <poll.h>
+    #include <errno.h>
 #endif
 
 #define MAX_PLAYERS 11
@@ -16,8 +38,71 @@
 #define DEFAULT_OVERS 3
 #define MAX_USERNAME 50
 #define MAX_PASSWORD 100
-#define MAX_USERS 100
 #define MAX_NAME_LENGTH 50
+#define MAX_THREADS 256
+#define CACHE_LINE 64
+#define LOCKSTEP_LANES 16
+#define ROLLOUT_BUDGET 0.05
+#define ROLLOUT_ROUND 1024
+#define MAX_ROLLOUTS 1000000
+#define ESTIMATE_ROUND 4096
+#define ESTIMATE_MAX_MATCHES 10000000
+#define LOG_MAGIC 0x31424d43u
+#define LOG_BLOCK_RECORDS 5440
+#define WRITER_SLOTS 16
+#define WRITER_SPIN 0.00005
+#define SUMMARY_MAGIC 0x31534d43u
+#define AGGREGATE_MAGIC 0x31414d43u
+#define SUMMARY_SEGMENT 65536
+#define USER_FILE "cricket_users.dat"
+#define USER_FILE_TMP "cricket_users.dat.tmp"
+#define USER_INDEX_FILE "cricket_users.idx"
+#define USER_INDEX_TMP "cricket_users.idx.tmp"
+#define USER_MAGIC 0x32554d43u
+#define USER_INDEX_MAGIC 0x31484d43u
+#define USER_FILE_VERSION 2
+#define USER_INDEX_MIN 1024
+#define SAVE_FILE "cricket_save.dat"
+#define SAVE_FILE_TMP "cricket_save.dat.tmp"
+#define SAVE_MAGIC 0x31474d43u
+#define SAVE_VERSION 2
+#define SAVE_BYTE_ORDER 0x0102u
+#define SAVE_ALIGN 64
+#define MAX_SIDES 256
+#define SUPER_OVER_LIMIT 16
+#define RATING_MIN 1
+#define RATING_MAX 99
+#define RATING_DEFAULT 50
+#define OUTCOMES 10
+#define MATCHUP_NEUTRAL (RATING_MAX - RATING_MIN)
+#define MATCHUP_ROWS (2 * MATCHUP_NEUTRAL + 1)
+#define SKILL_WICKET_SPREAD 3.0
+#define SKILL_RUN_SPREAD 2.0
+#define CALIBRATION_TARGETS 4
+#define CALIBRATION_PARAMS 8
+#define CALIBRATION_MATCHES 20000
+#define CALIBRATION_RESIDUALS (CALIBRATION_TARGETS + 7)
+#define CALIBRATION_MAX_EVALUATIONS 400
+#define CALIBRATION_STEP 0.05
+#define CALIBRATION_MIN_STEP 1e-3
+#define CALIBRATION_MIN_GAIN 1e-6
+#define CALIBRATION_SHAPE_PENALTY 1e-3
+#define MAX_POOL 4096
+#define SCREEN_ROWS 80
+#define SCREEN_COLS 120
+#define SCREEN_OUT 65536
+#define SCREEN_FPS 30
+#define SELECTION_CANDIDATES 2048
+#define SELECTION_FIRST_ROUND 128
+#define SELECTION_FINALISTS 8
+#define REPLAY_KEYFRAME 30
+#define STATS_BUCKETS 40
+#define SERVE_MAX_CLIENTS 64
+#define SERVE_MAX_REQUESTS 64
+#define SERVE_BUFFER 65536
+#define SERVE_ROUND 32768
+#define SERVE_MAX_OVERS 50
+#define SERVE_PARTIAL 0.25
 
 #ifdef _WIN32
     #define RESET ""
@@ -39,30 +124,44 @@
     #define WHITE "\033[37m"
 #endif
 
+/* The format kernels are one body compiled once per innings length, which
+   only happens if every copy is inlined into its caller. */
+#if defined(__GNUC__)
+    #define FORCE_INLINE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+    #define FORCE_INLINE static __forceinline
+#else
+    #define FORCE_INLINE static inline
+#endif
+
+typedef char PlayerName[MAX_NAME_LENGTH];
+
+/* Only what play_ball() reads or updates: ratings and integer counters.
+   Strike rate, overs and economy are worked out when they are shown. */
 typedef struct {
-    char name[MAX_NAME_LENGTH];
     int runs;
     int balls_faced;
     int fours;
     int sixes;
-    int is_out;
-    int is_bowler;
-    float strike_rate;
-    float overs;
     int balls_bowled;
     int runs_conceded;
-    int wickets;
-    float economy;
+    uint8_t wickets;
+    uint8_t is_out;
+    uint8_t is_bowler;
+    uint8_t batting;
+    uint8_t bowling;
 } Player;
 
+/* The scorecard comes first; the names after it are only read for
+   display, logs and saves. */
 typedef struct {
-    char name[MAX_NAME_LENGTH];
     Player players[MAX_PLAYERS];
     int player_count;
     int total_runs;
     int total_wickets;
     int total_balls;
-    float current_rr;
+    char name[MAX_NAME_LENGTH];
+    PlayerName player_names[MAX_PLAYERS];
 } Team;
 
 typedef struct {
@@ -71,20 +170,798 @@ typedef struct {
     int team_index;
 } User;
 
+/* cricket_users.dat is a header followed by fixed User records, appended
+   on signup. cricket_users.idx is an open-addressing hash table on the
+   username that is memory-mapped at startup. */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+} UserFileHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t reserved;
+} UserIndexHeader;
+
+typedef struct {
+    uint32_t tag;
+    uint32_t record;
+} UserSlot;
+
+typedef struct {
+    void* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+} MappedFile;
+
+typedef struct {
+    FILE* records;
+    uint32_t record_count;
+    MappedFile index;
+} UserStore;
+
 typedef struct {
     int max_overs;
     float wicket_probability;
+    float run_weights[7];
     char tournament_name[100];
 } GameConfig;
 
+typedef struct {
+    uint64_t s[4];
+    uint64_t draws;
+} Rng;
+
+/* Ball outcomes: 0-6 runs, or a wicket with 0-2 runs (outcomes 7-9). */
+typedef struct {
+    uint32_t keep[OUTCOMES];
+    uint8_t alias[OUTCOMES];
+} AliasSampler;
+
+/* Row r holds the outcome distribution, and its sampler, for a batsman
+   rated r - MATCHUP_NEUTRAL points above the bowler. cdf[r] is the same
+   distribution for inversion: running totals x 2^32, worst outcome first
+   (see outcome_by_value). */
+typedef struct OutcomeModel {
+    uint64_t wicket_threshold;
+    float run_weights[7];
+    double p[MATCHUP_ROWS][OUTCOMES];
+    AliasSampler sampler[MATCHUP_ROWS];
+    uint64_t cdf[MATCHUP_ROWS][OUTCOMES - 1];
+    struct OutcomeModel* next;
+} OutcomeModel;
+
+/* What the rules fix once the squads and overs are known, so a ball only
+   indexes: bowlers[t] is side t's attack in rotation order, and an innings
+   ends at max_balls or when all_out[t] of the batting side are out. */
+typedef struct {
+    int max_balls;
+    int all_out[MAX_TEAMS];
+    int bowler_count[MAX_TEAMS];
+    uint8_t bowlers[MAX_TEAMS][MAX_PLAYERS];
+} MatchPlan;
+
+typedef struct {
+    Team teams[MAX_TEAMS];
+    GameConfig config;
+    int currently_batting;
+    int first_innings;
+    int match_over;
+    int current_batsman;
+    int current_bowler_idx;
+    uint64_t wicket_threshold;
+    const OutcomeModel* model;
+    uint8_t matchup[MAX_TEAMS][MAX_PLAYERS][MAX_PLAYERS];
+    MatchPlan plan;
+    Rng rng;
+} MatchState;
+
+typedef struct {
+    int runs;
+    int is_wicket;
+    int innings_complete;
+    int batsman;
+    int bowler;
+} BallResult;
+
+typedef struct {
+    float win;
+    float tie;
+} WinTie;
+
+typedef struct {
+    int max_balls;
+    int all_out[MAX_TEAMS];
+    const OutcomeModel* model;
+    uint8_t* plan[MAX_TEAMS];
+    WinTie* chase[MAX_TEAMS];
+    WinTie* first[MAX_TEAMS];
+} WinProbTable;
+
+typedef struct {
+    long matches;
+    long wins[MAX_TEAMS];
+    long ties;
+    long bat_first_wins;
+    long long runs[MAX_TEAMS];
+    long long wickets[MAX_TEAMS];
+    long long first_innings_runs;
+    long long balls;
+    long long boundaries;
+    long long rng_draws;
+    uint64_t match_cycles[STATS_BUCKETS];
+} BatchStats;
+
+typedef struct {
+    BatchStats stats;
+    char pad[CACHE_LINE];
+} WorkerStats;
+
+typedef enum {
+    KERNEL_SCALAR,
+    KERNEL_LOCKSTEP
+} BatchKernel;
+
+typedef void (*FormatKernel)(MatchState* m, long first, long count, uint64_t seed, BatchStats* stats);
+
+typedef struct {
+    uint64_t s0[LOCKSTEP_LANES];
+    uint64_t s1[LOCKSTEP_LANES];
+    uint64_t s2[LOCKSTEP_LANES];
+    uint64_t s3[LOCKSTEP_LANES];
+    uint32_t runs[LOCKSTEP_LANES];
+    uint32_t wickets[LOCKSTEP_LANES];
+    uint32_t balls[LOCKSTEP_LANES];
+    uint32_t all_out[LOCKSTEP_LANES];
+    uint32_t target[LOCKSTEP_LANES];
+    uint32_t active[LOCKSTEP_LANES];
+    uint32_t done[LOCKSTEP_LANES];
+    uint32_t innings[LOCKSTEP_LANES];
+    uint32_t batting_first[LOCKSTEP_LANES];
+    uint32_t first_runs[LOCKSTEP_LANES];
+    uint32_t first_wickets[LOCKSTEP_LANES];
+    uint32_t boundaries[LOCKSTEP_LANES];
+} LockstepBatch;
+
+#ifdef _WIN32
+typedef HANDLE ThreadHandle;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE CondVar;
+#define THREAD_RETURN DWORD WINAPI
+#define THREAD_RESULT 0
+#else
+typedef pthread_t ThreadHandle;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+#define THREAD_RETURN void*
+#define THREAD_RESULT NULL
+#endif
+
+typedef void (*PoolTask)(void* ctx, int worker, long begin, long end);
+
+typedef struct {
+    long next;
+    long end;
+    char pad[CACHE_LINE - 2 * sizeof(long)];
+} WorkQueue;
+
+typedef struct ThreadPool ThreadPool;
+
+typedef struct {
+    ThreadPool* pool;
+    int index;
+} PoolWorker;
+
+struct ThreadPool {
+    int thread_count;
+    ThreadHandle threads[MAX_THREADS];
+    PoolWorker workers[MAX_THREADS];
+    WorkQueue queues[MAX_THREADS];
+    Mutex lock;
+    CondVar wake;
+    CondVar idle;
+    unsigned long generation;
+    int running;
+    int shutdown;
+    PoolTask task;
+    void* ctx;
+    long chunk_size;
+    long item_count;
+};
+
+/* On-disk event log: blocks of fixed 12-byte ball records in BASE.bin,
+   one index entry per match in BASE.idx and each distinct squad once in
+   BASE.rosters. All three are written in native byte order. */
+typedef struct {
+    uint32_t match_id;
+    uint16_t ball;
+    uint8_t innings;
+    uint8_t batsman;
+    uint8_t bowler;
+    uint8_t runs;
+    uint8_t wicket;
+    uint8_t pad;
+} BallRecord;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t crc;
+    uint32_t first_match;
+} LogBlockHeader;
+
+typedef struct {
+    uint64_t block_offset;
+    int64_t timestamp;
+    uint32_t match_id;
+    uint32_t first_record;
+    uint32_t ball_count;
+    uint32_t roster[MAX_TEAMS];
+    uint16_t runs[MAX_TEAMS];
+    uint16_t max_overs;
+    uint16_t margin;
+    uint8_t wickets[MAX_TEAMS];
+    int8_t winner;
+    uint8_t batting_first;
+    uint8_t pad[4];
+} MatchIndexEntry;
+
+typedef struct {
+    char team_name[MAX_NAME_LENGTH];
+    char players[MAX_PLAYERS][MAX_NAME_LENGTH];
+    uint8_t is_bowler[MAX_PLAYERS];
+    uint8_t player_count;
+} RosterRecord;
+
+/* One block waiting for the writer thread. `sequence` is the slot's
+   place in the ring: equal to the ticket when the slot is free for that
+   ticket's producer, ticket + 1 once the block is ready to write. */
+typedef struct {
+    uint64_t sequence;
+    BallRecord* records;
+    MatchIndexEntry* matches;
+    uint32_t count;
+    uint32_t match_count;
+    uint32_t records_capacity;
+    uint32_t matches_capacity;
+    uint32_t first_match;
+} WriterSlot;
+
+/* Blocks are written by a thread of the log's own. Workers hand them over
+   through `slots`, a bounded multi-producer ring, and only wait when it
+   is full. `sync_matches` and `sync_ms` are the durability policy: fsync
+   after that many matches or that many milliseconds, never if both are 0. */
+typedef struct {
+    FILE* data;
+    FILE* index;
+    FILE* rosters;
+    uint64_t data_end;
+    uint32_t next_match;
+    int failed;
+    RosterRecord* roster_cache;
+    int roster_count;
+    int roster_capacity;
+    Mutex lock;
+    WriterSlot slots[WRITER_SLOTS];
+    char pad[CACHE_LINE];
+    uint64_t head;
+    char pad2[CACHE_LINE];
+    ThreadHandle writer;
+    int writer_running;
+    int writer_idle;
+    int waiting;
+    int stopping;
+    int sync_matches;
+    int sync_ms;
+    Mutex wait_lock;
+    CondVar wake;
+    CondVar drained;
+} EventLog;
+
+typedef struct {
+    EventLog* log;
+    BallRecord* records;
+    MatchIndexEntry* matches;
+    uint32_t count;
+    uint32_t match_count;
+    uint32_t capacity;
+    uint32_t roster[MAX_TEAMS];
+    uint32_t match_id;
+    uint32_t first_record;
+    int batting_first;
+} LogBlock;
+
+/* Query store built from the event log: BASE.sum holds per-match
+   summaries as column segments, BASE.agg the career totals of every
+   player of every roster. */
+typedef enum {
+    COL_ROSTER0,
+    COL_ROSTER1,
+    COL_RUNS0,
+    COL_RUNS1,
+    COL_WICKETS0,
+    COL_WICKETS1,
+    COL_WINNER,
+    COL_BATTING_FIRST,
+    SUMMARY_COLUMNS
+} SummaryColumn;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+} SummaryHeader;
+
+typedef struct {
+    long count;
+    uint32_t* roster[MAX_TEAMS];
+    uint16_t* runs[MAX_TEAMS];
+    uint8_t* wickets[MAX_TEAMS];
+    int8_t* winner;
+    uint8_t* batting_first;
+} MatchSummary;
+
+typedef void (*SummaryVisitor)(void* ctx, const MatchSummary* segment);
+
+typedef struct {
+    int roster_count;
+    long* played;
+    long* won;
+    long* tied;
+} WinsQuery;
+
+typedef struct {
+    int roster_count;
+    const uint8_t* wanted;
+    uint32_t* histogram[2];
+} ScoresQuery;
+
+typedef struct {
+    uint64_t runs;
+    uint64_t balls_faced;
+    uint64_t fours;
+    uint64_t sixes;
+    uint64_t outs;
+    uint64_t balls_bowled;
+    uint64_t runs_conceded;
+    uint64_t wickets;
+} PlayerAggregate;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t roster_count;
+    uint64_t matches;
+} AggregateHeader;
+
+typedef struct {
+    const char* name;
+    const char* team;
+    PlayerAggregate stats;
+} PlayerTotal;
+
+typedef struct {
+    const MatchState* base;
+    MatchState* states;
+    WorkerStats* results;
+    uint64_t seed;
+    BatchKernel kernel;
+    LogBlock* events;
+} BatchJob;
+
+typedef struct {
+    long rollouts;
+    long wins[MAX_TEAMS];
+    long ties;
+    double runs[MAX_TEAMS];
+    double runs_sq[MAX_TEAMS];
+    char pad[CACHE_LINE];
+} RolloutStats;
+
+typedef struct {
+    const MatchState* snapshot;
+    MatchState* states;
+    RolloutStats* results;
+    uint64_t seed;
+    long first;
+} RolloutJob;
+
+/* Integer sums over the samples of an estimate, so the totals and the
+   round it stops at do not depend on the thread count. A sample is one
+   random stream: a match, or a match and its antithetic mirror. Index
+   [0] is the base setup, [1] the --compare one and [2] the change from
+   one to the other; [][0] counts team 1's wins and [][1] its run margin.
+   match_sq holds the per-match squares, for what plain sampling would
+   have given. */
+typedef struct {
+    long samples;
+    long long balls;
+    long long ties[2];
+    long long sum[3][2];
+    long long sq[3][2];
+    long long match_sq[2][2];
+    char pad[CACHE_LINE];
+} EstimateStats;
+
+typedef struct {
+    const MatchState* setups[2];
+    int setup_count;
+    int copies;
+    MatchState* states;
+    EstimateStats* results;
+    uint64_t seed;
+    long first;
+} EstimateJob;
+
+/* Tournament mode: any number of sides, split into groups that each play
+   a single round robin, then a reseeded knockout between the top sides of
+   every group. A league is one group. */
+typedef struct {
+    uint16_t home;
+    uint16_t away;
+    uint16_t round;
+    uint16_t group;
+} Fixture;
+
+typedef struct {
+    int runs[MAX_TEAMS];
+    int wickets[MAX_TEAMS];
+    int balls[MAX_TEAMS];
+    int winner;
+    int super_over;
+} FixtureResult;
+
+typedef struct {
+    int side;
+    int played;
+    int won;
+    int lost;
+    int tied;
+    int points;
+    long runs_for;
+    long balls_for;
+    long runs_against;
+    long balls_against;
+    double nrr;
+} TableRow;
+
+typedef struct {
+    const Team* sides;
+    int side_count;
+    int group_count;
+    int qualify;
+    int qualifiers;
+    GameConfig config;
+    const OutcomeModel* model;
+    Fixture* fixtures;
+    int fixture_count;
+    int round_count;
+    long streams;
+    uint64_t seed;
+} Tournament;
+
+typedef struct {
+    MatchState state;
+    FixtureResult* results;
+    Fixture* knockout;
+    TableRow* table;
+    int* bracket;
+    int* alive;
+    int champion;
+    long* qualified;
+    long* finals;
+    long* titles;
+    long long* points;
+    char pad[CACHE_LINE];
+} TournamentWork;
+
+typedef struct {
+    const Tournament* t;
+    TournamentWork* works;
+    const Fixture* fixtures;
+    FixtureResult* results;
+    uint64_t stream;
+    int knockout;
+} StageJob;
+
+typedef struct {
+    const Tournament* t;
+    TournamentWork* works;
+    long first;
+} TournamentJob;
+
+typedef struct {
+    int side;
+    long titles;
+    long qualified;
+} SideOdds;
+
+/* One --calibrate fit. Parameter 0 is the logit of the wicket
+   probability, the rest are log run weights for the runs listed in
+   free_runs; the first run with a non-zero weight stays fixed as the
+   scale. A negative target is not fitted. */
+typedef struct {
+    ThreadPool* pool;
+    MatchState base;
+    OutcomeModel model;
+    long matches;
+    uint64_t seed;
+    double target[CALIBRATION_TARGETS];
+    float start_weights[7];
+    int free_runs[7];
+    int free_count;
+    long evaluations;
+} Calibration;
+
+/* One --best-xi candidate: pool indices in batting order and a bit for
+   each position that bowls. Results add up over the halving rounds. */
+typedef struct {
+    uint16_t pick[MAX_PLAYERS];
+    uint16_t bowlers;
+    long played;
+    long wins;
+    long ties;
+} Lineup;
+
+typedef struct {
+    const Player* pool;
+    int size;
+    const Lineup* lineups;
+    MatchState* states;
+    BatchStats* results;
+    long first;
+    long matches;
+    long chunks;
+    uint64_t seed;
+} SelectionJob;
+
+typedef enum {
+    PEN_DEFAULT,
+    PEN_RED,
+    PEN_GREEN,
+    PEN_YELLOW,
+    PEN_BLUE,
+    PEN_MAGENTA,
+    PEN_CYAN,
+    PEN_WHITE
+} Pen;
+
+typedef struct {
+    uint32_t glyph[SCREEN_ROWS][SCREEN_COLS];
+    uint8_t pen[SCREEN_ROWS][SCREEN_COLS];
+    int height;
+} Frame;
+
+/* Double-buffered terminal: frames are drawn into `back`, and `front` is
+   what the terminal shows, as long as front_valid is set. */
+typedef struct {
+    Frame back;
+    Frame front;
+    int front_valid;
+    int row;
+    int col;
+    char out[SCREEN_OUT];
+    size_t out_len;
+} Screen;
+
+/* A recorded match opened for --replay: every ball in order, and a copy
+   of the whole match state before every REPLAY_KEYFRAME-th ball, so a
+   seek starts from the nearest keyframe instead of the first ball. */
+typedef struct {
+    BallRecord* balls;
+    int ball_count;
+    MatchState* keyframes;
+    int keyframe_count;
+    int batting_first;
+    MatchState state;
+    int position;
+} Replay;
+
+/* cricket_save.dat: a SaveHeader, the section table, then each section's
+   records starting on a SAVE_ALIGN boundary. Every field has a fixed width
+   and every record a fixed size, checked below, so a loaded file is used
+   in place from the mapping. Numbers are in native byte order, which the
+   header records. */
+typedef enum {
+    SAVE_TEAMS,
+    SAVE_MATCHES,
+    SAVE_BALLS,
+    SAVE_SECTIONS
+} SaveKind;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t byte_order;
+    uint32_t section_count;
+    uint32_t crc;
+    uint64_t size;
+} SaveHeader;
+
+typedef struct {
+    uint32_t kind;
+    uint32_t record_size;
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t offset;
+} SaveSection;
+
+typedef struct {
+    char name[MAX_NAME_LENGTH];
+    uint8_t is_bowler;
+    uint8_t is_out;
+    int32_t batting;
+    int32_t bowling;
+    int32_t runs;
+    int32_t balls_faced;
+    int32_t fours;
+    int32_t sixes;
+    int32_t balls_bowled;
+    int32_t runs_conceded;
+    int32_t wickets;
+    uint32_t reserved;
+} SavedPlayer;
+
+typedef struct {
+    char name[MAX_NAME_LENGTH];
+    uint8_t pad[2];
+    int32_t player_count;
+    int32_t total_runs;
+    int32_t total_wickets;
+    int32_t total_balls;
+    uint32_t reserved[2];
+    SavedPlayer players[MAX_PLAYERS];
+} SavedTeam;
+
+/* A match between two balls, with everything play_ball() reads: both
+   scorecards, who is on strike and bowling, and the random stream, so a
+   resumed match goes on exactly as it would have. The balls of it already
+   logged are balls[first_ball, first_ball + ball_count) of SAVE_BALLS. */
+typedef struct {
+    SavedTeam teams[MAX_TEAMS];
+    int32_t max_overs;
+    float wicket_probability;
+    float run_weights[7];
+    char tournament_name[100];
+    int32_t currently_batting;
+    int32_t first_innings;
+    int32_t match_over;
+    int32_t current_batsman;
+    int32_t current_bowler_idx;
+    uint32_t first_ball;
+    uint32_t ball_count;
+    uint32_t reserved;
+    uint64_t rng[4];
+} SavedMatch;
+
+/* A compiler that lays these out differently stops the build here. */
+typedef char save_header_layout[sizeof(SaveHeader) == 24 && sizeof(SaveSection) == 24 ? 1 : -1];
+typedef char saved_player_layout[sizeof(SavedPlayer) == 92 ? 1 : -1];
+typedef char saved_team_layout[sizeof(SavedTeam) == 1088 ? 1 : -1];
+typedef char saved_match_layout[sizeof(SavedMatch) == 2376 ? 1 : -1];
+typedef char ball_record_layout[sizeof(BallRecord) == 12 ? 1 : -1];
+typedef char user_record_layout[sizeof(User) == 120 ? 1 : -1];
+
+typedef struct {
+    MappedFile file;
+    SaveHeader* header;
+    SaveSection* sections;
+} SaveImage;
+
+typedef struct {
+    const MatchState* base;
+    SavedMatch* saved;
+    MatchState* states;
+    WorkerStats* results;
+    uint64_t seed;
+    int pause_at;
+} CheckpointJob;
+
+/* --serve: requests from every client are queued, and each round of the
+   shared pool plays a slice of every queued request. */
+typedef enum {
+    SERVE_SIMULATE,
+    SERVE_TOURNAMENT
+} ServeKind;
+
+typedef struct {
+    int fd;
+    int failed;
+    int finished;
+    size_t in_len;
+    char in[SERVE_BUFFER];
+} ServeClient;
+
+typedef struct {
+    ServeClient* client;
+    char id[32];
+    ServeKind kind;
+    OutcomeModel model;
+    MatchState base;
+    BatchKernel kernel;
+    uint64_t seed;
+    long total;
+    long done;
+    BatchStats stats;
+    Team* sides;
+    Tournament tournament;
+    TournamentWork* works;
+    double start;
+    double reported;
+} ServeRequest;
+
+typedef struct {
+    ServeRequest* request;
+    long offset;
+    long count;
+} ServeSegment;
+
+typedef struct {
+    ServeSegment segments[SERVE_MAX_REQUESTS];
+    int segment_count;
+    MatchState* states;
+    Mutex lock;
+} ServeJob;
+
+/* Engine instrumentation. The hooks below compile to nothing with
+   -DCRICMANIA_NO_STATS; otherwise each costs a clock read or two. */
+typedef enum {
+    PHASE_BALL,
+    PHASE_RENDER,
+    PHASE_PRESENT,
+    PHASE_HISTORY,
+    PHASE_LOAD,
+    PHASE_SAVE,
+    PHASE_BATCH,
+    PHASE_COUNT
+} Phase;
+
+/* Latencies are in clock cycles (TSC where there is one, else ns),
+   bucket b holding [2^b, 2^(b+1)). Balls and their RNG draws come from
+   play_ball(), so the lockstep kernel adds to PHASE_BATCH only. */
+typedef struct {
+    uint64_t calls[PHASE_COUNT];
+    uint64_t cycles[PHASE_COUNT];
+    uint64_t ball_cycles[STATS_BUCKETS];
+    uint64_t match_cycles[STATS_BUCKETS];
+    uint64_t balls;
+    uint64_t rng_draws;
+} EngineStats;
+
 static Team teams[MAX_TEAMS];
-static User users[MAX_USERS];
-static int user_count = 0;
+static UserStore user_store;
 static int logged_in_team_index = -1;
-static int currently_batting = 0;
-static int first_innings = 1;
-static int match_over = 0;
-static GameConfig config = {DEFAULT_OVERS, 0.15f, "CRICMANIA"};
+static GameConfig config = {DEFAULT_OVERS, 0.15f, {1, 1, 1, 1, 1, 1, 1}, "CRICMANIA"};
+static MatchState match;
+static Screen screen;
+static Rng game_rng;
+static ThreadPool* game_pool = NULL;
+static int game_threads = 0;
+static EventLog history;
+static LogBlock match_events;
+static int history_open = 0;
+static int match_paused = 0;
+static int log_sync_matches = 0;
+static int log_sync_ms = 0;
+#ifndef CRICMANIA_NO_STATS
+static EngineStats engine_stats;
+#endif
+static Mutex stats_lock;
+static volatile sig_atomic_t stats_requested = 0;
+static volatile sig_atomic_t serve_stop = 0;
+static int stats_json = 0;
+static uint64_t stats_clock_start;
+static double stats_time_start;
+static const int outcome_runs[OUTCOMES] = {0, 1, 2, 3, 4, 5, 6, 0, 1, 2};
+static const int outcome_wicket[OUTCOMES] = {0, 0, 0, 0, 0, 0, 0, 1, 1, 1};
+static const int outcome_by_value[OUTCOMES] = {7, 8, 9, 0, 1, 2, 3, 4, 5, 6};
 
 void initialize_game(void);
 void main_menu(void);
@@ -93,20 +970,116 @@ int login_system(void);
 int signup_system(void);
 void manage_team(Team* team);
 void simulate_match(void);
-void simulate_ball(void);
-void display_scoreboard(int clear);
-void display_match_result(void);
+void simulate_ball(MatchState* m);
+void auto_complete_match(MatchState* m);
+int play_ball(MatchState* m, BallResult* result);
+int replay_ball(MatchState* m, const BallRecord* rec, BallResult* result);
+void match_init(MatchState* m, const Team squads[MAX_TEAMS], const GameConfig* cfg);
+void match_init_model(MatchState* m, const Team squads[MAX_TEAMS], const GameConfig* cfg,
+                      const OutcomeModel* model);
+void reset_match_state(MatchState* m);
+void match_prepare(MatchState* m);
+int player_rating(int rating);
+int match_is_uniform(const MatchState* m);
+const OutcomeModel* outcome_model_for(const GameConfig* cfg);
+int count_bowlers(const Team* team);
+int decide_match_result(const MatchState* m, int* margin, char* margin_type);
+int run_command_line(int argc, char** argv);
+void run_batch(MatchState* m, long first, long count, uint64_t seed, BatchStats* stats, LogBlock* events);
+void rng_seed(Rng* rng, uint64_t seed);
+void rng_stream(Rng* rng, uint64_t seed, uint64_t stream);
+void rng_jump(Rng* rng);
+uint64_t rng_next(Rng* rng);
+uint32_t rng_below(Rng* rng, uint32_t bits, uint32_t n);
+void run_interactive(void);
+void stats_init(void);
+void stats_dump(FILE* out, int json);
+void stats_poll(void);
+ThreadPool* pool_create(int thread_count);
+void pool_run(ThreadPool* pool, PoolTask task, void* ctx, long item_count, long chunk_size);
+void pool_destroy(ThreadPool* pool);
+void run_lockstep_batch(const MatchState* base, long first, long count, uint64_t seed,
+                        BatchStats* stats);
+void run_parallel_batch(ThreadPool* pool, const MatchState* base, long matches,
+                        uint64_t seed, BatchKernel kernel, BatchStats* total, EventLog* log);
+long run_rollouts(ThreadPool* pool, const MatchState* snapshot, double budget, RolloutStats* total);
+void show_win_prediction(const MatchState* m);
+int cpu_count(void);
+double now_seconds(void);
+int load_roster(const char* path, Team* team);
+int copy_name(char* dst, const char* src);
+void default_roster(Team* team, const char* name);
+void display_scoreboard(const MatchState* m, int clear);
+void render_scoreboard(Screen* s, const MatchState* m);
+WinProbTable* winprob_build(const MatchState* m);
+void winprob_free(WinProbTable* t);
+void winprob_query(const WinProbTable* t, const MatchState* m, float win[MAX_TEAMS], float* tie);
+const WinProbTable* winprob_for(const MatchState* m);
+void display_match_result(MatchState* m);
 void save_game_data(void);
 int load_game_data(void);
+int user_store_open(UserStore* s);
+void user_store_close(UserStore* s);
+long user_store_find(UserStore* s, const char* username, User* user);
+int user_store_add(UserStore* s, const User* user);
 void cleanup_and_exit(void);
-void show_man_of_the_match(void);
+void show_man_of_the_match(const MatchState* m);
 void clear_screen(void);
+void screen_begin(Screen* s);
+void screen_printf(Screen* s, Pen pen, const char* format, ...);
+void screen_present(Screen* s);
+void screen_print_inline(Screen* s);
+void screen_invalidate(Screen* s);
 void safe_input(char* buffer, int size, const char* prompt);
 int safe_int_input(const char* prompt);
 void simple_hash(const char* input, char* output);
 float calculate_strike_rate(int runs, int balls);
 float calculate_economy(int runs, float overs);
-void save_match_history(Team *winner, int margin, const char *type);
+float player_strike_rate(const Player* p);
+float player_overs(const Player* p);
+float player_economy(const Player* p);
+float team_run_rate(const Team* t);
+void save_match_history(const MatchState* m);
+int event_log_open(EventLog* log, const char* base);
+void event_log_close(EventLog* log);
+uint32_t event_log_roster(EventLog* log, const Team* team);
+int log_block_init(LogBlock* b, EventLog* log, int max_overs);
+void log_block_free(LogBlock* b);
+void log_begin_match(LogBlock* b, uint32_t match_id, const MatchState* m);
+void log_ball(LogBlock* b, int innings, int ball, const BallResult* r);
+void log_end_match(LogBlock* b, const MatchState* m);
+int log_block_flush(LogBlock* b);
+int run_log_scan(const char* base);
+long history_ingest(const char* base, long* added);
+long summary_scan(const char* base, unsigned mask, SummaryVisitor visit, void* ctx);
+void summary_free(MatchSummary* s);
+int run_history_query(const char* base, const char* query, const char* team, int top);
+int replay_build(Replay* r, const MatchState* start, BallRecord* balls, int count);
+void replay_seek(Replay* r, int position);
+void replay_free(Replay* r);
+int run_replay(const char* base, uint32_t match_id, const MatchState* seeded, long match_number,
+               uint64_t seed, int at_ball);
+int save_create(SaveImage* img, const char* path, const uint32_t counts[SAVE_SECTIONS]);
+int save_commit(SaveImage* img, const char* tmp_path, const char* path);
+int save_open(SaveImage* img, const char* path);
+void save_close(SaveImage* img);
+void* save_section(const SaveImage* img, int kind, uint32_t* count);
+void team_to_saved(const Team* t, SavedTeam* s);
+void team_from_saved(const SavedTeam* s, Team* t);
+void match_to_saved(const MatchState* m, SavedMatch* s);
+void match_from_saved(const SavedMatch* s, MatchState* m);
+int save_game_file(void);
+int load_game_file(void);
+int load_roster_list(const char* path, Team* sides, int max_sides);
+int load_player_pool(const char* path, char name[MAX_NAME_LENGTH], Player** players, PlayerName** names);
+int run_best_xi(const char* pool_path, const Team* opponent, int wanted, long first_round,
+                uint64_t seed, int threads, const char* xi_path);
+int tournament_init(Tournament* t, const Team* sides, int side_count, int group_count,
+                    int qualify, const GameConfig* cfg, const OutcomeModel* model, uint64_t seed);
+void tournament_free(Tournament* t);
+void tournament_play(const Tournament* t, TournamentWork* works, int worker, long run, ThreadPool* pool);
+int run_tournament(const Tournament* t, long runs, int threads);
+int run_serve(const char* path, int threads, uint64_t seed, BatchKernel kernel);
 
 #ifdef _WIN32
 void enable_colors(void) {
@@ -136,97 +1109,480 @@ char getch_silent(void) {
 }
 #endif
 
-int main(void) {
-    srand(time(NULL));
-    enable_colors();
-    
-    welcome_screen();
-    initialize_game();
-    main_menu();
-    cleanup_and_exit();
-    
-    return 0;
+#ifdef _WIN32
+static void mutex_init(Mutex* m) { InitializeCriticalSection(m); }
+static void mutex_lock(Mutex* m) { EnterCriticalSection(m); }
+static void mutex_unlock(Mutex* m) { LeaveCriticalSection(m); }
+static void mutex_destroy(Mutex* m) { DeleteCriticalSection(m); }
+static void cond_init(CondVar* c) { InitializeConditionVariable(c); }
+static void cond_wait(CondVar* c, Mutex* m) { SleepConditionVariableCS(c, m, INFINITE); }
+static void cond_broadcast(CondVar* c) { WakeAllConditionVariable(c); }
+static void cond_destroy(CondVar* c) { (void)c; }
+static void cond_wait_ms(CondVar* c, Mutex* m, int ms) { SleepConditionVariableCS(c, m, (DWORD)ms); }
+
+static int file_sync(FILE* f) {
+    return fflush(f) == 0 && _commit(_fileno(f)) == 0;
 }
 
-void initialize_game(void) {
-    strncpy(teams[0].name, "OMOR EKUSHEY HALL", MAX_NAME_LENGTH - 1);
-    strncpy(teams[1].name, "SHAHID SMRITY HALL", MAX_NAME_LENGTH - 1);
-    
-    for (int i = 0; i < MAX_TEAMS; i++) {
-        teams[i].player_count = 0;
-        teams[i].total_runs = 0;
-        teams[i].total_wickets = 0;
-        teams[i].total_balls = 0;
-        teams[i].current_rr = 0.0f;
+static int thread_create(ThreadHandle* t, DWORD (WINAPI *fn)(LPVOID), void* arg) {
+    *t = CreateThread(NULL, 0, fn, arg, 0, NULL);
+    return *t != NULL;
+}
+
+static void thread_join(ThreadHandle t) {
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+}
+
+int cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+}
+
+double now_seconds(void) {
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+}
+
+/* Maps a file read-write, creating it with `size` bytes if size is not 0,
+   or mapping its current length if it is. */
+static int map_file(MappedFile* f, const char* path, size_t size) {
+    LARGE_INTEGER length;
+
+    memset(f, 0, sizeof(*f));
+    f->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                          OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (f->file == INVALID_HANDLE_VALUE) return 0;
+    if (size == 0) {
+        if (!GetFileSizeEx(f->file, &length) || length.QuadPart == 0) {
+            CloseHandle(f->file);
+            return 0;
+        }
+        size = (size_t)length.QuadPart;
     }
-    
-    user_count = load_game_data();
-    printf(CYAN "Game initialized successfully!\n" RESET);
+    f->mapping = CreateFileMappingA(f->file, NULL, PAGE_READWRITE,
+                                    (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+    f->data = f->mapping ? MapViewOfFile(f->mapping, FILE_MAP_WRITE, 0, 0, size) : NULL;
+    if (!f->data) {
+        if (f->mapping) CloseHandle(f->mapping);
+        CloseHandle(f->file);
+        return 0;
+    }
+    f->size = size;
+    return 1;
 }
 
-void welcome_screen(void) {
-    clear_screen();
-    printf(CYAN "╔══════════════════════════════════════════════════════════╗\n");
-    printf("║                    CRICKET SIMULATOR                     ║\n");
-    printf("║                                                          ║\n");
-    printf("╚══════════════════════════════════════════════════════════╝\n" RESET);
-    printf(YELLOW "\nEXPERIENCE THE THRILL OF CRICKET SIMULATION!\n");
-    printf("TWO LEGENDARY TEAMS BATTLE IT OUT IN AN EPIC SHOWDOWN.\n\n" RESET);
-    
-    printf("PRESS ANY KEY TO CONTINUE...");
-    getch_silent();
-    printf("\n");
+static void unmap_file(MappedFile* f) {
+    if (f->data) {
+        UnmapViewOfFile(f->data);
+        CloseHandle(f->mapping);
+        CloseHandle(f->file);
+    }
+    f->data = NULL;
+    f->size = 0;
 }
+#else
+static void mutex_init(Mutex* m) { pthread_mutex_init(m, NULL); }
+static void mutex_lock(Mutex* m) { pthread_mutex_lock(m); }
+static void mutex_unlock(Mutex* m) { pthread_mutex_unlock(m); }
+static void mutex_destroy(Mutex* m) { pthread_mutex_destroy(m); }
+static void cond_init(CondVar* c) { pthread_cond_init(c, NULL); }
+static void cond_wait(CondVar* c, Mutex* m) { pthread_cond_wait(c, m); }
+static void cond_broadcast(CondVar* c) { pthread_cond_broadcast(c); }
+static void cond_destroy(CondVar* c) { pthread_cond_destroy(c); }
 
-void main_menu(void) {
-    int choice;
-    
-    do {
-        if (match_over) break;
-        
-        clear_screen();
-        printf(WHITE "\n╔═══════════════ MAIN MENU ═══════════════╗\n");
-        printf("║  1. LOGIN                               ║\n");
-        printf("║  2. SIGNUP                              ║\n");
-        printf("║  3. MANAGE TEAM                         ║\n");
-        printf("║  4. SIMULATE MATCH                      ║\n");
-        printf("║  5. VIEW STATISTICS                     ║\n");
-        printf("║  6. SAVE & EXIT                         ║\n");
-        printf("╚═════════════════════════════════════════╝\n" RESET);
-        
-        choice = safe_int_input("ENTER YOUR CHOICE (1–6):");
-        
-        switch (choice) {
-            case 1:
-                if (login_system()) {
-                    printf(GREEN "\nLOGIN SUCCESSFUL! MANAGING... %s\n" RESET,
-                           teams[logged_in_team_index].name);
-                    printf("PRESS ANY KEY TO CONTINUE...");
-                    getch_silent();
-                } else {
-                    printf(RED "\nLogin failed! Invalid credentials.\n" RESET);
-                    printf("PRESS ANY KEY TO CONTINUE...");
-                    getch_silent();
-                }
-                break;
-                
-            case 2:
-                if (signup_system()) {
-                    printf(GREEN "\nSIGNUP SUCCESSFUL! YOU CAN NOW LOGIN.\n" RESET);
-                    save_game_data();
-                } else {
-                    printf(RED "\nSIGNUP FAILED! USERNAME MAY EXIST OR PASSWORD IS WEAK.\n" RESET);
-                }
-                printf("PRESS ANY KEY TO CONTINUE...");
-                getch_silent();
-                break;
-                
-            case 3:
-                if (logged_in_team_index != -1) {
-                    manage_team(&teams[logged_in_team_index]);
-                } else {
-                    printf(RED "\nPLEASE LOGIN FIRST!\n" RESET);
-                    printf("PRESS ANY KEY TO CONTINUE...");
+static void cond_wait_ms(CondVar* c, Mutex* m, int ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(c, m, &ts);
+}
+
+static int file_sync(FILE* f) {
+    return fflush(f) == 0 && fsync(fileno(f)) == 0;
+}
+
+static int thread_create(ThreadHandle* t, void* (*fn)(void*), void* arg) {
+    return pthread_create(t, NULL, fn, arg) == 0;
+}
+
+static void thread_join(ThreadHandle t) {
+    pthread_join(t, NULL);
+}
+
+int cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int map_file(MappedFile* f, const char* path, size_t size) {
+    struct stat st;
+
+    memset(f, 0, sizeof(*f));
+    f->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (f->fd < 0) return 0;
+    if (size == 0) {
+        if (fstat(f->fd, &st) != 0 || st.st_size == 0) {
+            close(f->fd);
+            return 0;
+        }
+        size = (size_t)st.st_size;
+    } else if (ftruncate(f->fd, (off_t)size) != 0) {
+        close(f->fd);
+        return 0;
+    }
+    f->data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+    if (f->data == MAP_FAILED) {
+        f->data = NULL;
+        close(f->fd);
+        return 0;
+    }
+    f->size = size;
+    return 1;
+}
+
+static void unmap_file(MappedFile* f) {
+    if (f->data) {
+        munmap(f->data, f->size);
+        close(f->fd);
+    }
+    f->data = NULL;
+    f->size = 0;
+}
+#endif
+
+static inline uint64_t stats_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)(now_seconds() * 1e9);
+#endif
+}
+
+static inline int stats_bucket(uint64_t cycles) {
+    int b = 0;
+    while (cycles > 1 && b < STATS_BUCKETS - 1) {
+        cycles >>= 1;
+        b++;
+    }
+    return b;
+}
+
+#ifdef CRICMANIA_NO_STATS
+    #define STATS_START(t)
+    #define STATS_STOP(phase, t)
+    #define STATS_BALL(t, draws, match_over) (void)(draws)
+    #define STATS_MATCH(stats, t, draws)
+    #define STATS_CHUNK(part, scalar, t)
+#else
+    #define STATS_START(t) uint64_t t = stats_clock()
+    #define STATS_STOP(phase, t) stats_phase((phase), stats_clock() - (t))
+    #define STATS_BALL(t, draws, match_over) stats_ball(stats_clock() - (t), (draws), (match_over))
+    #define STATS_MATCH(stats, t, draws) stats_match((stats), stats_clock() - (t), (draws))
+    #define STATS_CHUNK(part, scalar, t) stats_fold((part), (scalar), stats_clock() - (t))
+#endif
+
+static void stats_signal(int sig) {
+    (void)sig;
+    stats_requested = 1;
+}
+
+void stats_init(void) {
+    mutex_init(&stats_lock);
+    stats_clock_start = stats_clock();
+    stats_time_start = now_seconds();
+#ifndef _WIN32
+    signal(SIGUSR1, stats_signal);
+#endif
+}
+
+#ifndef CRICMANIA_NO_STATS
+static inline void stats_phase(Phase phase, uint64_t cycles) {
+    engine_stats.calls[phase]++;
+    engine_stats.cycles[phase] += cycles;
+}
+
+/* One ball of an interactive match; the match's total goes into the match
+   histogram when it ends. */
+static uint64_t current_match_cycles;
+
+static void stats_ball(uint64_t cycles, uint64_t draws, int match_over) {
+    stats_phase(PHASE_BALL, cycles);
+    engine_stats.ball_cycles[stats_bucket(cycles)]++;
+    engine_stats.balls++;
+    engine_stats.rng_draws += draws;
+    current_match_cycles += cycles;
+    if (match_over) {
+        engine_stats.match_cycles[stats_bucket(current_match_cycles)]++;
+        current_match_cycles = 0;
+    }
+}
+
+static inline void stats_match(BatchStats* stats, uint64_t cycles, uint64_t draws) {
+    stats->match_cycles[stats_bucket(cycles)]++;
+    stats->rng_draws += (long long)draws;
+}
+
+/* Adds one finished batch chunk to the totals. Workers fold a chunk at a
+   time, which is also where a batch answers a stats signal. */
+static void stats_fold(const BatchStats* part, int scalar, uint64_t cycles) {
+    mutex_lock(&stats_lock);
+    stats_phase(PHASE_BATCH, cycles);
+    if (scalar) {
+        engine_stats.balls += (uint64_t)part->balls;
+        engine_stats.rng_draws += (uint64_t)part->rng_draws;
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            engine_stats.match_cycles[b] += part->match_cycles[b];
+        }
+    }
+    if (stats_requested) {
+        stats_requested = 0;
+        stats_dump(stderr, stats_json);
+    }
+    mutex_unlock(&stats_lock);
+}
+#endif
+
+/* Called between steps of the interactive game. */
+void stats_poll(void) {
+    if (stats_requested) {
+        stats_requested = 0;
+        mutex_lock(&stats_lock);
+        stats_dump(stderr, stats_json);
+        mutex_unlock(&stats_lock);
+    }
+}
+
+#ifndef CRICMANIA_NO_STATS
+static const char* phase_names[PHASE_COUNT] = {
+    "ball", "render", "present", "history", "load", "save", "batch"
+};
+
+/* Upper edge, in cycles, of the bucket holding quantile q. */
+static double histogram_quantile(const uint64_t* h, double q) {
+    uint64_t total = 0, seen = 0;
+    for (int b = 0; b < STATS_BUCKETS; b++) total += h[b];
+    if (total == 0) return 0.0;
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        seen += h[b];
+        if (seen >= q * total) return ldexp(1.0, b + 1);
+    }
+    return ldexp(1.0, STATS_BUCKETS);
+}
+
+static void dump_histogram(FILE* out, const char* name, const uint64_t* h, double us, int json) {
+    uint64_t total = 0;
+    for (int b = 0; b < STATS_BUCKETS; b++) total += h[b];
+    
+    if (!json && total == 0) return;
+    if (json) {
+        fprintf(out, "\"%s\":{\"count\":%llu,\"p50_us\":%.3f,\"p90_us\":%.3f,\"p99_us\":%.3f,\"buckets\":[",
+                name, (unsigned long long)total, histogram_quantile(h, 0.5) * us,
+                histogram_quantile(h, 0.9) * us, histogram_quantile(h, 0.99) * us);
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            fprintf(out, "%s%llu", b ? "," : "", (unsigned long long)h[b]);
+        }
+        fprintf(out, "]}");
+        return;
+    }
+    
+    fprintf(out, "%s LATENCY (%llu): P50 <= %.2f us  P90 <= %.2f us  P99 <= %.2f us\n",
+            name, (unsigned long long)total, histogram_quantile(h, 0.5) * us,
+            histogram_quantile(h, 0.9) * us, histogram_quantile(h, 0.99) * us);
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        if (h[b] == 0) continue;
+        fprintf(out, "  %10.2f - %10.2f us %12llu\n",
+                ldexp(1.0, b) * us, ldexp(1.0, b + 1) * us, (unsigned long long)h[b]);
+    }
+}
+
+/* Text for people, or one line of JSON for log collectors. Phase times
+   are converted with the clock rate measured since stats_init(). */
+void stats_dump(FILE* out, int json) {
+    const EngineStats* s = &engine_stats;
+    double elapsed = now_seconds() - stats_time_start;
+    double hz = elapsed > 0.0 ? (double)(stats_clock() - stats_clock_start) / elapsed : 1e9;
+    double us = hz > 0.0 ? 1e6 / hz : 0.0;
+    double per_ball = s->balls ? (double)s->rng_draws / s->balls : 0.0;
+
+    if (json) {
+        fprintf(out, "{\"elapsed_s\":%.3f,\"clock_hz\":%.0f,\"phases\":{", elapsed, hz);
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            fprintf(out, "%s\"%s\":{\"calls\":%llu,\"cycles\":%llu,\"mean_us\":%.3f}", p ? "," : "",
+                    phase_names[p], (unsigned long long)s->calls[p], (unsigned long long)s->cycles[p],
+                    s->calls[p] ? s->cycles[p] * us / s->calls[p] : 0.0);
+        }
+        fprintf(out, "},\"balls\":%llu,\"rng_draws\":%llu,\"rng_per_ball\":%.4f,",
+                (unsigned long long)s->balls, (unsigned long long)s->rng_draws, per_ball);
+        dump_histogram(out, "ball_latency", s->ball_cycles, us, 1);
+        fprintf(out, ",");
+        dump_histogram(out, "match_latency", s->match_cycles, us, 1);
+        fprintf(out, "}\n");
+    } else {
+        fprintf(out, "ENGINE STATS AFTER %.2fs (CLOCK %.3f GHz)\n", elapsed, hz / 1e9);
+        fprintf(out, "%-10s %12s %12s %12s %14s\n", "PHASE", "CALLS", "TOTAL ms", "MEAN us", "CYCLES/CALL");
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            if (s->calls[p] == 0) continue;
+            fprintf(out, "%-10s %12llu %12.3f %12.3f %14.0f\n", phase_names[p],
+                    (unsigned long long)s->calls[p], s->cycles[p] * us / 1e3,
+                    s->cycles[p] * us / s->calls[p], (double)s->cycles[p] / s->calls[p]);
+        }
+        fprintf(out, "BALLS: %llu  RNG DRAWS: %llu  DRAWS/BALL: %.4f\n",
+                (unsigned long long)s->balls, (unsigned long long)s->rng_draws, per_ball);
+        dump_histogram(out, "BALL", s->ball_cycles, us, 0);
+        dump_histogram(out, "MATCH", s->match_cycles, us, 0);
+    }
+    fflush(out);
+}
+#else
+void stats_dump(FILE* out, int json) {
+    fprintf(out, json ? "{\"stats\":\"compiled out\"}\n" : "STATS WERE COMPILED OUT (CRICMANIA_NO_STATS)\n");
+    fflush(out);
+}
+#endif
+
+static void stats_at_exit(void) {
+    mutex_lock(&stats_lock);
+    stats_dump(stderr, stats_json);
+    mutex_unlock(&stats_lock);
+}
+
+/* bench/cricket_bench.c includes this file with CRICMANIA_NO_MAIN and
+   supplies its own main(). */
+#ifndef CRICMANIA_NO_MAIN
+int main(int argc, char** argv) {
+    stats_init();
+    if (argc > 1) {
+        return run_command_line(argc, argv);
+    }
+    
+    rng_seed(&game_rng, (uint64_t)time(NULL));
+    run_interactive();
+    
+    return 0;
+}
+#endif
+
+void run_interactive(void) {
+    enable_colors();
+    
+    welcome_screen();
+    initialize_game();
+    main_menu();
+    cleanup_and_exit();
+}
+
+void initialize_game(void) {
+    copy_name(teams[0].name, "OMOR EKUSHEY HALL");
+    copy_name(teams[1].name, "SHAHID SMRITY HALL");
+    
+    for (int i = 0; i < MAX_TEAMS; i++) {
+        teams[i].player_count = 0;
+        teams[i].total_runs = 0;
+        teams[i].total_wickets = 0;
+        teams[i].total_balls = 0;
+    }
+    
+    match_init(&match, teams, &config);
+    if (!load_game_data()) {
+        printf(RED "COULD NOT OPEN %s! ACCOUNTS WILL NOT BE SAVED.\n" RESET, USER_FILE);
+    }
+    history_open = event_log_open(&history, "history");
+    if (history_open && !log_block_init(&match_events, &history, config.max_overs)) {
+        event_log_close(&history);
+        history_open = 0;
+    }
+    STATS_START(load_start);
+    int loaded = load_game_file();
+    STATS_STOP(PHASE_LOAD, load_start);
+    if (loaded == 0) {
+        printf(RED "%s IS DAMAGED OR FROM ANOTHER VERSION! STARTING WITH EMPTY SQUADS.\n" RESET, SAVE_FILE);
+    } else if (match_paused) {
+        printf(CYAN "RESTORED A PAUSED MATCH: %s %d/%d VS %s %d/%d\n" RESET,
+               match.teams[0].name, match.teams[0].total_runs, match.teams[0].total_wickets,
+               match.teams[1].name, match.teams[1].total_runs, match.teams[1].total_wickets);
+    }
+    printf(CYAN "Game initialized successfully!\n" RESET);
+}
+
+void welcome_screen(void) {
+    clear_screen();
+    printf(CYAN "╔══════════════════════════════════════════════════════════╗\n");
+    printf("║                    CRICKET SIMULATOR                     ║\n");
+    printf("║                                                          ║\n");
+    printf("╚══════════════════════════════════════════════════════════╝\n" RESET);
+    printf(YELLOW "\nEXPERIENCE THE THRILL OF CRICKET SIMULATION!\n");
+    printf("TWO LEGENDARY TEAMS BATTLE IT OUT IN AN EPIC SHOWDOWN.\n\n" RESET);
+    
+    printf("PRESS ANY KEY TO CONTINUE...");
+    getch_silent();
+    printf("\n");
+}
+
+void main_menu(void) {
+    int choice;
+    
+    do {
+        if (match.match_over) break;
+        
+        stats_poll();
+        clear_screen();
+        printf(WHITE "\n╔═══════════════ MAIN MENU ═══════════════╗\n");
+        printf("║  1. LOGIN                               ║\n");
+        printf("║  2. SIGNUP                              ║\n");
+        printf("║  3. MANAGE TEAM                         ║\n");
+        printf("║  4. SIMULATE MATCH                      ║\n");
+        printf("║  5. VIEW STATISTICS                     ║\n");
+        printf("║  6. SAVE & EXIT                         ║\n");
+        printf("╚═════════════════════════════════════════╝\n" RESET);
+        
+        choice = safe_int_input("ENTER YOUR CHOICE (1–6):");
+        
+        switch (choice) {
+            case 1:
+                if (login_system()) {
+                    printf(GREEN "\nLOGIN SUCCESSFUL! MANAGING... %s\n" RESET,
+                           teams[logged_in_team_index].name);
+                    printf("PRESS ANY KEY TO CONTINUE...");
+                    getch_silent();
+                } else {
+                    printf(RED "\nLogin failed! Invalid credentials.\n" RESET);
+                    printf("PRESS ANY KEY TO CONTINUE...");
+                    getch_silent();
+                }
+                break;
+                
+            case 2:
+                if (signup_system()) {
+                    printf(GREEN "\nSIGNUP SUCCESSFUL! YOU CAN NOW LOGIN.\n" RESET);
+                    save_game_data();
+                } else {
+                    printf(RED "\nSIGNUP FAILED! USERNAME MAY EXIST OR PASSWORD IS WEAK.\n" RESET);
+                }
+                printf("PRESS ANY KEY TO CONTINUE...");
+                getch_silent();
+                break;
+                
+            case 3:
+                if (logged_in_team_index != -1) {
+                    manage_team(&teams[logged_in_team_index]);
+                } else {
+                    printf(RED "\nPLEASE LOGIN FIRST!\n" RESET);
+                    printf("PRESS ANY KEY TO CONTINUE...");
                     getch_silent();
                 }
                 break;
@@ -242,13 +1598,12 @@ void main_menu(void) {
                 break;
                 
             case 5:
-                display_scoreboard(1);
+                display_scoreboard(&match, 1);
                 printf("PRESS ANY KEY TO CONTINUE...");
                 getch_silent();
                 break;
                 
             case 6:
-                save_game_data();
                 printf(CYAN "\nGAME SAVED SUCCESSFULLY! THANKS FOR PLAYING!\n" RESET);
                 break;
                 
@@ -284,12 +1639,11 @@ int login_system(void) {
     
     simple_hash(password, password_hash);
     
-    for (int j = 0; j < user_count; j++) {
-        if (strcmp(users[j].username, username) == 0 &&
-            strcmp(users[j].password_hash, password_hash) == 0) {
-            logged_in_team_index = users[j].team_index;
-            return 1;
-        }
+    User user;
+    if (user_store_find(&user_store, username, &user) >= 0 &&
+        strcmp(user.password_hash, password_hash) == 0) {
+        logged_in_team_index = user.team_index;
+        return 1;
     }
     
     return 0;
@@ -299,18 +1653,12 @@ int signup_system(void) {
     char username[MAX_USERNAME];
     char password[MAX_PASSWORD];
     int team_choice;
-    
-    if (user_count >= MAX_USERS) {
-        printf(RED "MAXIMUM USER REACHED!\n" RESET);
-        return 0;
-    }
+    User user;
     
     safe_input(username, MAX_USERNAME, "ENTER NEW USERNAME: ");
     
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, username) == 0) {
-            return 0;
-        }
+    if (user_store_find(&user_store, username, &user) >= 0) {
+        return 0;
     }
     
     safe_input(password, MAX_PASSWORD, "ENTER NEW PASSWORD: ");
@@ -329,12 +1677,12 @@ int signup_system(void) {
         return 0;
     }
     
-    strncpy(users[user_count].username, username, MAX_USERNAME - 1);
-    simple_hash(password, users[user_count].password_hash);
-    users[user_count].team_index = team_choice - 1;
-    user_count++;
+    memset(&user, 0, sizeof(user));
+    strncpy(user.username, username, MAX_USERNAME - 1);
+    simple_hash(password, user.password_hash);
+    user.team_index = team_choice - 1;
     
-    return 1;
+    return user_store_add(&user_store, &user);
 }
 
 void manage_team(Team* team) {
@@ -359,20 +1707,21 @@ void manage_team(Team* team) {
                 } else {
                     char name[MAX_NAME_LENGTH];
                     safe_input(name, MAX_NAME_LENGTH, "ENTER PLAYER NAME: ");
+                    int batting = safe_int_input("BATTING RATING (1-99, 0 FOR AVERAGE): ");
+                    int bowling = safe_int_input("BOWLING RATING (1-99, 0 FOR AVERAGE): ");
                     
-                    strncpy(team->players[team->player_count].name, name, MAX_NAME_LENGTH - 1);
+                    copy_name(team->player_names[team->player_count], name);
+                    team->players[team->player_count].batting = (uint8_t)player_rating(batting);
+                    team->players[team->player_count].bowling = (uint8_t)player_rating(bowling);
                     team->players[team->player_count].runs = 0;
                     team->players[team->player_count].balls_faced = 0;
                     team->players[team->player_count].fours = 0;
                     team->players[team->player_count].sixes = 0;
                     team->players[team->player_count].is_out = 0;
                     team->players[team->player_count].is_bowler = 0;
-                    team->players[team->player_count].strike_rate = 0.0f;
-                    team->players[team->player_count].overs = 0.0f;
                     team->players[team->player_count].balls_bowled = 0;
                     team->players[team->player_count].runs_conceded = 0;
                     team->players[team->player_count].wickets = 0;
-                    team->players[team->player_count].economy = 0.0f;
                     team->player_count++;
                     
                     printf(GREEN "PLAYER ADDED SUCCESSFULLY!\n" RESET);
@@ -391,7 +1740,7 @@ void manage_team(Team* team) {
                     
                     int found = 0;
                     for (int i = 0; i < team->player_count; i++) {
-                        if (strcmp(team->players[i].name, name) == 0) {
+                        if (strcmp(team->player_names[i], name) == 0) {
                             team->players[i].is_bowler = 1;
                             found = 1;
                             printf(GREEN "PLAYER MARKED AS BOWLER SUCCESSFULLY!\n" RESET);
@@ -417,8 +1766,10 @@ void manage_team(Team* team) {
                     printf("NO PLAYERS ADDED YET.\n");
                 } else {
                     for (int i = 0; i < team->player_count; i++) {
-                        printf("%d. %s%s\n", i + 1, team->players[i].name,
-                               team->players[i].is_bowler ? " (BOWLER)" : "");
+                        printf("%d. %s%s  BAT %d  BOWL %d\n", i + 1, team->player_names[i],
+                               team->players[i].is_bowler ? " (BOWLER)" : "",
+                               player_rating(team->players[i].batting),
+                               player_rating(team->players[i].bowling));
                     }
                 }
                 
@@ -436,9 +1787,10 @@ void manage_team(Team* team) {
                     
                     int found = 0;
                     for (int i = 0; i < team->player_count; i++) {
-                        if (strcmp(team->players[i].name, name) == 0) {
+                        if (strcmp(team->player_names[i], name) == 0) {
                             for (int j = i; j < team->player_count - 1; j++) {
                                 team->players[j] = team->players[j + 1];
+                                memcpy(team->player_names[j], team->player_names[j + 1], MAX_NAME_LENGTH);
                             }
                             team->player_count--;
                             found = 1;
@@ -467,263 +1819,596 @@ void manage_team(Team* team) {
     } while (choice != 5);
 }
 
-void simulate_match(void) {
-    int bowler_count_team0 = 0, bowler_count_team1 = 0;
-    
-    for (int i = 0; i < teams[0].player_count; i++) {
-        if (teams[0].players[i].is_bowler) bowler_count_team0++;
-    }
-    for (int i = 0; i < teams[1].player_count; i++) {
-        if (teams[1].players[i].is_bowler) bowler_count_team1++;
+int count_bowlers(const Team* team) {
+    int count = 0;
+    for (int i = 0; i < team->player_count; i++) {
+        if (team->players[i].is_bowler) count++;
     }
+    return count;
+}
+
+void match_init(MatchState* m, const Team squads[MAX_TEAMS], const GameConfig* cfg) {
+    match_init_model(m, squads, cfg, outcome_model_for(cfg));
+}
+
+/* match_init() with a model the caller builds and frees, for callers that
+   must not add to the cache behind outcome_model_for(). */
+void match_init_model(MatchState* m, const Team squads[MAX_TEAMS], const GameConfig* cfg,
+                      const OutcomeModel* model) {
+    memcpy(m->teams, squads, sizeof(m->teams));
+    m->config = *cfg;
+    m->currently_batting = 0;
+    m->wicket_threshold = (uint64_t)(cfg->wicket_probability * 4294967296.0);
+    m->model = model;
+    match_prepare(m);
+    rng_seed(&m->rng, 0);
+    reset_match_state(m);
+}
+
+void reset_match_state(MatchState* m) {
+    m->match_over = 0;
+    m->first_innings = 1;
+    m->current_batsman = 0;
+    m->current_bowler_idx = 0;
     
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        m->teams[t].total_runs = 0;
+        m->teams[t].total_wickets = 0;
+        m->teams[t].total_balls = 0;
+        
+        for (int i = 0; i < m->teams[t].player_count; i++) {
+            m->teams[t].players[i].runs = 0;
+            m->teams[t].players[i].balls_faced = 0;
+            m->teams[t].players[i].fours = 0;
+            m->teams[t].players[i].sixes = 0;
+            m->teams[t].players[i].is_out = 0;
+            m->teams[t].players[i].balls_bowled = 0;
+            m->teams[t].players[i].runs_conceded = 0;
+            m->teams[t].players[i].wickets = 0;
+        }
+    }
+}
+
+/* Sets up a fresh match between the two squads and tosses for it.
+   Returns 0 if the squads cannot play. */
+static int start_match(MatchState* m) {
     if (teams[0].player_count < 2 || teams[1].player_count < 2 ||
-        bowler_count_team0 < 2 || bowler_count_team1 < 2) {
+        count_bowlers(&teams[0]) < 2 || count_bowlers(&teams[1]) < 2) {
         printf(RED "BOTH TEAMS NEED AT LEAST 2 PLAYERS AND 2 BOWLERS TO START!\n" RESET);
         printf("PRESS ANY KEY TO CONTINUE...");
         getch_silent();
-        return;
+        return 0;
     }
     
-    match_over = 0;
-    first_innings = 1;
-    currently_batting = rand() % 2;
+    match_init(m, teams, &config);
+    m->rng = game_rng;
+    rng_jump(&game_rng);
+    m->currently_batting = (int)(rng_next(&m->rng) >> 63);
+    
+    if (history_open) {
+        /* Balls of an abandoned match are dropped, never written. */
+        match_events.count = 0;
+        match_events.match_count = 0;
+        for (int t = 0; t < MAX_TEAMS; t++) {
+            match_events.roster[t] = event_log_roster(&history, &m->teams[t]);
+        }
+        log_begin_match(&match_events, history.next_match, m);
+    }
     
-    printf(CYAN "\nTOSS: %s WILL BAT FIRST!\n" RESET, teams[currently_batting].name);
+    printf(CYAN "\nTOSS: %s WILL BAT FIRST!\n" RESET, m->teams[m->currently_batting].name);
     printf("PRESS ANY KEY TO CONTINUE...");
     getch_silent();
+    return 1;
+}
+
+void simulate_match(void) {
+    MatchState* m = &match;
+    int resume = 0;
     
-    for (int t = 0; t < MAX_TEAMS; t++) {
-        teams[t].total_runs = 0;
-        teams[t].total_wickets = 0;
-        teams[t].total_balls = 0;
-        teams[t].current_rr = 0.0f;
-        
-        for (int i = 0; i < teams[t].player_count; i++) {
-            teams[t].players[i].runs = 0;
-            teams[t].players[i].balls_faced = 0;
-            teams[t].players[i].fours = 0;
-            teams[t].players[i].sixes = 0;
-            teams[t].players[i].is_out = 0;
-            teams[t].players[i].strike_rate = 0.0f;
-            teams[t].players[i].overs = 0.0f;
-            teams[t].players[i].balls_bowled = 0;
-            teams[t].players[i].runs_conceded = 0;
-            teams[t].players[i].wickets = 0;
-            teams[t].players[i].economy = 0.0f;
-        }
+    if (match_paused) {
+        printf(CYAN "\nA MATCH IS IN PROGRESS: %s %d/%d VS %s %d/%d\n" RESET,
+               m->teams[0].name, m->teams[0].total_runs, m->teams[0].total_wickets,
+               m->teams[1].name, m->teams[1].total_runs, m->teams[1].total_wickets);
+        printf(WHITE "1. RESUME IT\n2. START A NEW MATCH\n" RESET);
+        resume = safe_int_input("ENTER CHOICE: ") == 1;
+        match_paused = 0;
     }
+    if (!resume && !start_match(m)) return;
     
     printf(CYAN "\n╔══════════════ MATCH STARTED ══════════════╗\n");
-    printf("║  %s  VS  %s  ║\n", teams[0].name, teams[1].name);
+    printf("║  %s  VS  %s  ║\n", m->teams[0].name, m->teams[1].name);
     printf("╚════════════════════════════════════════════╝\n" RESET);
     
     int ball_choice;
     do {
-        if (match_over) break;
+        if (m->match_over) break;
         
+        stats_poll();
         printf(WHITE "\n1. SIMULATE NEXT BALL\n");
         printf("2. VIEW CURRENT STATUS\n");
         printf("3. AUTO-COMPLETE MATCH\n");
-        printf("4. BACK TO MAIN MENU\n" RESET);
+        printf("4. BACK TO MAIN MENU\n");
+        printf("5. WIN PROBABILITY\n" RESET);
         
         ball_choice = safe_int_input("ENTER CHOICE: ");
         
         switch (ball_choice) {
             case 1:
-                simulate_ball();
+                simulate_ball(m);
                 break;
             case 2:
-                display_scoreboard(1);
+                display_scoreboard(m, 1);
                 break;
             case 3:
-                while (!match_over && teams[currently_batting].total_balls < config.max_overs * 6) {
-                    simulate_ball();
-                }
+                auto_complete_match(m);
                 break;
             case 4:
+                match_paused = 1;
                 return;
+            case 5:
+                show_win_prediction(m);
+                break;
             default:
                 printf(RED "INVALID CHOICE!\n" RESET);
         }
         
-        if (match_over) {
-            display_match_result();
+        if (m->match_over) {
+            display_match_result(m);
             break;
         }
         
     } while (ball_choice != 4);
 }
 
-void simulate_ball(void) {
-    if (match_over || teams[currently_batting].total_balls >= config.max_overs * 6) {
-        return;
+int player_rating(int rating) {
+    if (rating <= 0) return RATING_DEFAULT;
+    return rating > RATING_MAX ? RATING_MAX : rating;
+}
+
+/* Outcome distribution for a batsman rated `delta` points above the bowler.
+   At delta 0 it is the base model: a wicket with the configured
+   probability (0-2 runs), otherwise 0-6 runs in proportion to the run
+   weights. A better batsman gets out less often and tilts the runs
+   towards boundaries. */
+static void matchup_distribution(double wicket_probability, const float run_weights[7],
+                                 int delta, double p[OUTCOMES]) {
+    double skill = (double)delta / (RATING_MAX - RATING_MIN);
+    double wicket = wicket_probability * pow(SKILL_WICKET_SPREAD, -skill);
+    double weight[7], total = 0.0;
+    
+    if (wicket > 1.0) wicket = 1.0;
+    for (int r = 0; r < 7; r++) {
+        weight[r] = run_weights[r] * pow(SKILL_RUN_SPREAD, skill * (r - 3) / 3.0);
+        total += weight[r];
+    }
+    for (int k = 0; k < OUTCOMES; k++) {
+        p[k] = outcome_wicket[k] ? wicket / 3.0 : (1.0 - wicket) * weight[k] / total;
     }
+}
+
+/* Vose's alias method: column c keeps its own outcome when the low 32
+   bits of the draw are below keep[c] and takes alias[c] otherwise. */
+static void alias_build(const double p[OUTCOMES], AliasSampler* s) {
+    double scaled[OUTCOMES];
+    int small[OUTCOMES], large[OUTCOMES];
+    int small_count = 0, large_count = 0;
     
-    static int current_batsman = 0;
-    static int current_bowler_idx = 0;
+    for (int k = 0; k < OUTCOMES; k++) {
+        scaled[k] = p[k] * OUTCOMES;
+        if (scaled[k] < 1.0) {
+            small[small_count++] = k;
+        } else {
+            large[large_count++] = k;
+        }
+    }
+    while (small_count > 0 && large_count > 0) {
+        int lo = small[--small_count];
+        int hi = large[--large_count];
+        
+        s->keep[lo] = (uint32_t)(scaled[lo] * 4294967296.0);
+        s->alias[lo] = (uint8_t)hi;
+        scaled[hi] -= 1.0 - scaled[lo];
+        if (scaled[hi] < 1.0) {
+            small[small_count++] = hi;
+        } else {
+            large[large_count++] = hi;
+        }
+    }
+    /* Whatever is left is full up to rounding error. */
+    while (large_count > 0) {
+        int k = large[--large_count];
+        s->keep[k] = UINT32_MAX;
+        s->alias[k] = (uint8_t)k;
+    }
+    while (small_count > 0) {
+        int k = small[--small_count];
+        s->keep[k] = UINT32_MAX;
+        s->alias[k] = (uint8_t)k;
+    }
+}
+
+static void outcome_model_build(OutcomeModel* model, const GameConfig* cfg) {
+    model->wicket_threshold = (uint64_t)(cfg->wicket_probability * 4294967296.0);
+    memcpy(model->run_weights, cfg->run_weights, sizeof(model->run_weights));
+    for (int row = 0; row < MATCHUP_ROWS; row++) {
+        matchup_distribution((double)model->wicket_threshold / 4294967296.0, model->run_weights,
+                             row - MATCHUP_NEUTRAL, model->p[row]);
+        alias_build(model->p[row], &model->sampler[row]);
+        
+        double total = 0.0;
+        for (int k = 0; k < OUTCOMES - 1; k++) {
+            total += model->p[row][outcome_by_value[k]];
+            model->cdf[row][k] = (uint64_t)(total * 4294967296.0);
+        }
+    }
+}
+
+/* One sampler per rating difference, built the first time a wicket
+   probability and set of run weights is used and kept until exit. Models
+   are created from match_init() on the main thread only; workers just
+   read them. */
+const OutcomeModel* outcome_model_for(const GameConfig* cfg) {
+    static OutcomeModel* models = NULL;
+    uint64_t wicket_threshold = (uint64_t)(cfg->wicket_probability * 4294967296.0);
     
-    if (current_batsman >= teams[currently_batting].player_count) {
-        current_batsman = 0;
+    for (OutcomeModel* model = models; model; model = model->next) {
+        if (model->wicket_threshold == wicket_threshold &&
+            memcmp(model->run_weights, cfg->run_weights, sizeof(model->run_weights)) == 0) {
+            return model;
+        }
     }
     
-    int bowling_team = 1 - currently_batting;
-    Player* bowler = NULL;
-    int bowler_count = 0;
+    OutcomeModel* model = (OutcomeModel*)malloc(sizeof(OutcomeModel));
+    if (!model) {
+        fprintf(stderr, "NOT ENOUGH MEMORY FOR THE OUTCOME MODEL\n");
+        exit(1);
+    }
+    outcome_model_build(model, cfg);
+    model->next = models;
+    models = model;
+    return model;
+}
+
+/* Fills the batsman x bowler table and the match plan for the two sides
+   now in m->teams under m->config. */
+void match_prepare(MatchState* m) {
+    MatchPlan* plan = &m->plan;
     
-    for (int i = 0; i < teams[bowling_team].player_count; i++) {
-        if (teams[bowling_team].players[i].is_bowler) {
-            if (bowler_count == current_bowler_idx) {
-                bowler = &teams[bowling_team].players[i];
-                break;
+    plan->max_balls = m->config.max_overs * 6;
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        const Team* batting = &m->teams[t];
+        const Team* bowling = &m->teams[1 - t];
+        
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            int bat = player_rating(batting->players[i].batting);
+            for (int j = 0; j < MAX_PLAYERS; j++) {
+                int bowl = player_rating(bowling->players[j].bowling);
+                m->matchup[t][i][j] = (uint8_t)(MATCHUP_NEUTRAL + bat - bowl);
             }
-            bowler_count++;
+        }
+        
+        plan->all_out[t] = batting->player_count - 1;
+        plan->bowler_count[t] = 0;
+        for (int i = 0; i < batting->player_count; i++) {
+            if (batting->players[i].is_bowler) plan->bowlers[t][plan->bowler_count[t]++] = (uint8_t)i;
         }
     }
-    
-    if (bowler == NULL) {
-        printf(RED "NO BOWLER AVAILABLE!\n" RESET);
-        return;
+}
+
+/* True when the runs are equally likely and every batsman is rated the
+   same as every bowler he can face, so each ball follows the distribution
+   the lockstep kernel samples. */
+int match_is_uniform(const MatchState* m) {
+    for (int r = 1; r < 7; r++) {
+        if (m->config.run_weights[r] != m->config.run_weights[0]) return 0;
     }
-    
-    Player* batsman = &teams[currently_batting].players[current_batsman];
-    
-    int runs = rand() % 7;
-    int is_wicket = (rand() % 100) < (config.wicket_probability * 100);
-    
-    if (is_wicket && runs > 2) runs = rand() % 3;
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        const Team* bowling = &m->teams[1 - t];
+        for (int i = 0; i < m->teams[t].player_count; i++) {
+            for (int j = 0; j < bowling->player_count; j++) {
+                if (bowling->players[j].is_bowler && m->matchup[t][i][j] != MATCHUP_NEUTRAL) return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Index of the player bowling the current over, or -1 if the bowling side
+   has no bowler for it. */
+static inline int current_bowler(const MatchState* m) {
+    int bowling = 1 - m->currently_batting;
+    
+    if (m->current_bowler_idx >= m->plan.bowler_count[bowling]) return -1;
+    return m->plan.bowlers[bowling][m->current_bowler_idx];
+}
+
+/* Books a delivery whose outcome is already known against the current
+   batsman and the given bowler, and moves the match on. */
+static inline void score_ball(MatchState* m, int bowler_index, int runs, int is_wicket, BallResult* result) {
+    int bowling_team = 1 - m->currently_batting;
+    Player* bowler = &m->teams[bowling_team].players[bowler_index];
+    Player* batsman = &m->teams[m->currently_batting].players[m->current_batsman];
     
     batsman->runs += runs;
     batsman->balls_faced++;
     if (runs == 4) batsman->fours++;
     if (runs == 6) batsman->sixes++;
-    batsman->strike_rate = calculate_strike_rate(batsman->runs, batsman->balls_faced);
     
     bowler->runs_conceded += runs;
     bowler->balls_bowled++;
-    bowler->overs = bowler->balls_bowled / 6 + (bowler->balls_bowled % 6) / 10.0f;
-    bowler->economy = calculate_economy(bowler->runs_conceded, bowler->overs);
     
-    teams[currently_batting].total_runs += runs;
-    teams[currently_batting].total_balls++;
-    teams[currently_batting].current_rr = calculate_economy(teams[currently_batting].total_runs,
-                                                           teams[currently_batting].total_balls / 6.0f);
+    m->teams[m->currently_batting].total_runs += runs;
+    m->teams[m->currently_batting].total_balls++;
     
-    printf(YELLOW "\nBall Result: %d runs" RESET, runs);
     if (is_wicket) {
-        printf(RED " - WICKET!" RESET);
         batsman->is_out = 1;
-        teams[currently_batting].total_wickets++;
+        m->teams[m->currently_batting].total_wickets++;
         bowler->wickets++;
-        current_batsman++;
+        m->current_batsman++;
     }
     
-    printf("\nSCORE: %d/%d (%d.%d overs)\n",
-           teams[currently_batting].total_runs,
-           teams[currently_batting].total_wickets,
-           teams[currently_batting].total_balls / 6,
-           teams[currently_batting].total_balls % 6);
-    
-    if (teams[currently_batting].total_balls >= config.max_overs * 6 ||
-        teams[currently_batting].total_wickets >= teams[currently_batting].player_count - 1 ||
-        (!first_innings && teams[currently_batting].total_runs > teams[1 - currently_batting].total_runs)) {
-        
-        if (first_innings) {
-            printf(GREEN "\nFIRST INNINGS COMPLETE!\n" RESET);
-            printf("TARGET: %d RUNS\n", teams[currently_batting].total_runs + 1);
-            
-            first_innings = 0;
-            currently_batting = 1 - currently_batting;
-            current_batsman = 0;
-            current_bowler_idx = 0;
+    result->runs = runs;
+    result->is_wicket = is_wicket;
+    result->batsman = (int)(batsman - m->teams[m->currently_batting].players);
+    result->bowler = bowler_index;
+    
+    /* Rotate before a finished innings resets the attack, so the next
+       innings always opens with its first bowler. */
+    if (bowler->balls_bowled % 6 == 0 && bowler->balls_bowled > 0) {
+        int next = m->current_bowler_idx + 1;
+        m->current_bowler_idx = next < m->plan.bowler_count[bowling_team] ? next : 0;
+    }
+    
+    if (m->teams[m->currently_batting].total_balls >= m->plan.max_balls ||
+        m->teams[m->currently_batting].total_wickets >= m->plan.all_out[m->currently_batting] ||
+        (!m->first_innings && m->teams[m->currently_batting].total_runs > m->teams[1 - m->currently_batting].total_runs)) {
+        
+        result->innings_complete = 1;
+        if (m->first_innings) {
+            m->first_innings = 0;
+            m->currently_batting = 1 - m->currently_batting;
+            m->current_batsman = 0;
+            m->current_bowler_idx = 0;
         } else {
-            match_over = 1;
+            m->match_over = 1;
         }
     }
+}
+
+/* Advances the match by one delivery without touching the terminal.
+   Returns 1 if a ball was bowled, 0 if the innings/match is already over
+   and -1 if the bowling side has no bowler for the current over. */
+int play_ball(MatchState* m, BallResult* result) {
+    result->runs = 0;
+    result->is_wicket = 0;
+    result->innings_complete = 0;
+    result->batsman = 0;
+    result->bowler = 0;
+    
+    if (m->match_over || m->teams[m->currently_batting].total_balls >= m->plan.max_balls) {
+        return 0;
+    }
     
-    if (bowler->balls_bowled % 6 == 0 && bowler->balls_bowled > 0) {
-        int total_bowlers = 0;
-        for (int i = 0; i < teams[bowling_team].player_count; i++) {
-            if (teams[bowling_team].players[i].is_bowler) total_bowlers++;
+    if (m->current_batsman >= m->teams[m->currently_batting].player_count) {
+        m->current_batsman = 0;
+    }
+    
+    int bowler_index = current_bowler(m);
+    if (bowler_index < 0) {
+        return -1;
+    }
+    
+    /* One draw: the high half picks a column of the matchup's alias
+       sampler, the low half decides between the column and its alias. */
+    const AliasSampler* sampler =
+        &m->model->sampler[m->matchup[m->currently_batting][m->current_batsman][bowler_index]];
+    uint64_t draw = rng_next(&m->rng);
+    int column = (int)(((draw >> 32) * OUTCOMES) >> 32);
+    int outcome = (uint32_t)draw < sampler->keep[column] ? column : sampler->alias[column];
+    
+    score_ball(m, bowler_index, outcome_runs[outcome], outcome_wicket[outcome], result);
+    return 1;
+}
+
+/* Books a ball from the event log instead of drawing one. Returns 0 if the
+   record does not fit the match as replayed so far: the wrong innings,
+   ball, batsman or bowler, or a ball after the match is over. */
+int replay_ball(MatchState* m, const BallRecord* rec, BallResult* result) {
+    memset(result, 0, sizeof(*result));
+    
+    if (m->match_over || m->teams[m->currently_batting].total_balls >= m->plan.max_balls) {
+        return 0;
+    }
+    if (m->current_batsman >= m->teams[m->currently_batting].player_count) {
+        m->current_batsman = 0;
+    }
+    
+    int bowler_index = current_bowler(m);
+    if (bowler_index < 0 || rec->innings != (m->first_innings ? 1 : 2) ||
+        rec->ball != m->teams[m->currently_batting].total_balls + 1 ||
+        rec->batsman != m->current_batsman || rec->bowler != bowler_index ||
+        rec->runs > 6 || rec->wicket > 1) {
+        return 0;
+    }
+    
+    score_ball(m, bowler_index, rec->runs, rec->wicket, result);
+    return 1;
+}
+
+/* Bowls one ball and logs it to the match history. */
+static int advance_ball(MatchState* m, BallResult* result) {
+    int batting = m->currently_batting;
+    int was_first_innings = m->first_innings;
+    uint64_t draws = m->rng.draws;
+    STATS_START(start);
+    int status = play_ball(m, result);
+    
+    if (status > 0) {
+        STATS_BALL(start, m->rng.draws - draws, m->match_over);
+    }
+    if (status > 0 && history_open) {
+        log_ball(&match_events, was_first_innings ? 1 : 2, m->teams[batting].total_balls, result);
+    }
+    return status;
+}
+
+void simulate_ball(MatchState* m) {
+    BallResult result;
+    int batting = m->currently_batting;
+    int was_first_innings = m->first_innings;
+    int status = advance_ball(m, &result);
+    
+    if (status < 0) {
+        printf(RED "NO BOWLER AVAILABLE!\n" RESET);
+        return;
+    }
+    if (status == 0) {
+        return;
+    }
+    
+    printf(YELLOW "\nBall Result: %d runs" RESET, result.runs);
+    if (result.is_wicket) {
+        printf(RED " - WICKET!" RESET);
+    }
+    
+    printf("\nSCORE: %d/%d (%d.%d overs)\n",
+           m->teams[batting].total_runs,
+           m->teams[batting].total_wickets,
+           m->teams[batting].total_balls / 6,
+           m->teams[batting].total_balls % 6);
+    
+    if (result.innings_complete && was_first_innings) {
+        printf(GREEN "\nFIRST INNINGS COMPLETE!\n" RESET);
+        printf("TARGET: %d RUNS\n", m->teams[batting].total_runs + 1);
+    }
+}
+
+/* Plays out the match with the scoreboard updating in place. Frames are
+   capped at SCREEN_FPS and only the changed cells are redrawn, so drawing
+   never holds the simulation back. */
+void auto_complete_match(MatchState* m) {
+    BallResult result;
+    double next_frame = 0.0;
+    
+    screen_invalidate(&screen);
+    while (!m->match_over) {
+        if (advance_ball(m, &result) <= 0) break;
+        stats_poll();
+        
+        double now = now_seconds();
+        if (now >= next_frame || m->match_over) {
+            render_scoreboard(&screen, m);
+            screen_present(&screen);
+            next_frame = now + 1.0 / SCREEN_FPS;
         }
-        current_bowler_idx = (current_bowler_idx + 1) % total_bowlers;
     }
 }
 
-void display_scoreboard(int clear) {
-    if (clear) {
-        clear_screen();
+/* Draws the scoreboard into the screen's back buffer. */
+void render_scoreboard(Screen* s, const MatchState* m) {
+    STATS_START(start);
+    screen_begin(s);
+    screen_printf(s, PEN_CYAN, "╔════════════════ SCOREBOARD ════════════════╗\n");
+    
+    if (!m->match_over && m->teams[0].total_balls + m->teams[1].total_balls > 0) {
+        const WinProbTable* table = winprob_for(m);
+        if (table) {
+            float win[MAX_TEAMS], tie;
+            winprob_query(table, m, win, &tie);
+            screen_printf(s, PEN_GREEN, "\nWIN PROBABILITY: %s %.1f%% | %s %.1f%% | TIE %.1f%%\n",
+                          m->teams[0].name, 100.0f * win[0],
+                          m->teams[1].name, 100.0f * win[1], 100.0f * tie);
+        }
     }
-    printf(CYAN "╔════════════════ SCOREBOARD ════════════════╗\n" RESET);
     
     for (int t = 0; t < MAX_TEAMS; t++) {
-        printf(YELLOW "\n%s: %d/%d (%d.%d overs)\n" RESET,
-               teams[t].name,
-               teams[t].total_runs,
-               teams[t].total_wickets,
-               teams[t].total_balls / 6,
-               teams[t].total_balls % 6);
+        screen_printf(s, PEN_YELLOW, "\n%s: %d/%d (%d.%d overs)\n",
+                      m->teams[t].name,
+                      m->teams[t].total_runs,
+                      m->teams[t].total_wickets,
+                      m->teams[t].total_balls / 6,
+                      m->teams[t].total_balls % 6);
         
-        if (teams[t].total_balls > 0) {
-            printf("CURRENT RR: %.2f\n", teams[t].current_rr);
+        if (m->teams[t].total_balls > 0) {
+            screen_printf(s, PEN_DEFAULT, "CURRENT RR: %.2f\n", team_run_rate(&m->teams[t]));
         }
         
-        printf("\nBATSMEN:\n");
-        printf("%-15s %s %s %s %s %s\n", "NAME", "RUNS", "BALLS", "4s", "6s", "SR");
-        printf("─────────────────────────────────────────────\n");
+        screen_printf(s, PEN_DEFAULT, "\nBATSMEN:\n");
+        screen_printf(s, PEN_DEFAULT, "%-15s %s %s %s %s %s\n", "NAME", "RUNS", "BALLS", "4s", "6s", "SR");
+        screen_printf(s, PEN_DEFAULT, "─────────────────────────────────────────────\n");
         
-        for (int i = 0; i < teams[t].player_count; i++) {
-            Player* p = &teams[t].players[i];
+        for (int i = 0; i < m->teams[t].player_count; i++) {
+            const Player* p = &m->teams[t].players[i];
             if (p->balls_faced > 0) {
-                printf("%-15s %4d %5d %2d %2d %5.1f%s\n",
-                       p->name, p->runs, p->balls_faced, p->fours, p->sixes, p->strike_rate,
-                       p->is_out ? " *" : "");
+                screen_printf(s, PEN_DEFAULT, "%-15s %4d %5d %2d %2d %5.1f%s\n",
+                              m->teams[t].player_names[i], p->runs, p->balls_faced, p->fours, p->sixes,
+                              player_strike_rate(p),
+                              p->is_out ? " *" : "");
             }
         }
         
-        printf("\nBOWLERS:\n");
-        printf("%-15s %s %s %s %s\n", "NAME", "OVERS", "RUNS", "WKTS", "ECON");
-        printf("─────────────────────────────────────────────\n");
+        screen_printf(s, PEN_DEFAULT, "\nBOWLERS:\n");
+        screen_printf(s, PEN_DEFAULT, "%-15s %s %s %s %s\n", "NAME", "OVERS", "RUNS", "WKTS", "ECON");
+        screen_printf(s, PEN_DEFAULT, "─────────────────────────────────────────────\n");
         
-        for (int i = 0; i < teams[t].player_count; i++) {
-            Player* p = &teams[t].players[i];
+        for (int i = 0; i < m->teams[t].player_count; i++) {
+            const Player* p = &m->teams[t].players[i];
             if (p->is_bowler && p->balls_bowled > 0) {
-                printf("%-15s %5.1f %4d %4d %5.2f\n",
-                       p->name, p->overs, p->runs_conceded, p->wickets, p->economy);
+                screen_printf(s, PEN_DEFAULT, "%-15s %5.1f %4d %4d %5.2f\n",
+                              m->teams[t].player_names[i], player_overs(p), p->runs_conceded,
+                              p->wickets, player_economy(p));
             }
         }
         
-        if (t == 0) printf("\n" CYAN "═════════════════════════════════════════════\n" RESET);
+        if (t == 0) screen_printf(s, PEN_CYAN, "\n═════════════════════════════════════════════\n");
+    }
+    STATS_STOP(PHASE_RENDER, start);
+}
+
+/* With `clear` the board takes over the screen; otherwise it is printed
+   where the cursor is, as part of the match result. */
+void display_scoreboard(const MatchState* m, int clear) {
+    render_scoreboard(&screen, m);
+    if (clear) {
+        screen_invalidate(&screen);
+        screen_present(&screen);
+    } else {
+        screen_print_inline(&screen);
     }
-    
     printf("\n");
 }
 
-void display_match_result(void) {
+int decide_match_result(const MatchState* m, int* margin, char* margin_type) {
+    const Team *teamA = &m->teams[0];
+    const Team *teamB = &m->teams[1];
+    
+    *margin = 0;
+    margin_type[0] = '\0';
+    
+    if (teamA->total_runs > teamB->total_runs) {
+        *margin = teamA->total_runs - teamB->total_runs;
+        strcpy(margin_type, "RUNS");
+        return 0;
+    }
+    if (teamB->total_runs > teamA->total_runs) {
+        *margin = (teamB->player_count - 1) - teamB->total_wickets;
+        strcpy(margin_type, "WICKETS");
+        return 1;
+    }
+    return -1;
+}
+
+void display_match_result(MatchState* m) {
     clear_screen();
 
     printf(BLUE "╔════════════════ MATCH RESULT ════════════════╗\n" RESET);
 
-    Team *teamA = &teams[0];
-    Team *teamB = &teams[1];
-
-    Team *winner = NULL;
     char margin_type[20];
     int margin = 0;
+    int winner = decide_match_result(m, &margin, margin_type);
 
-    if (teamA->total_runs > teamB->total_runs) {
-        winner = teamA;
-        margin = teamA->total_runs - teamB->total_runs;
-        strcpy(margin_type, "RUNS");
-    }
-    else if (teamB->total_runs > teamA->total_runs) {
-        winner = teamB;
-        margin = (teamB->player_count - 1) - teamB->total_wickets;
-        strcpy(margin_type, "WICKETS");
-    }
-
-    if (winner) {
-        printf("║   %s WINS THE MATCH!                        ║\n", winner->name);
+    if (winner >= 0) {
+        printf("║   %s WINS THE MATCH!                        ║\n", m->teams[winner].name);
         printf("║   WON BY %d %s                              ║\n", margin, margin_type);
     } else {
         printf("║                MATCH TIED!                  ║\n");
@@ -731,34 +2416,36 @@ void display_match_result(void) {
 
     printf("╚═══════════════════════════════════════════════╝\n" RESET);
 
-    show_man_of_the_match();
-    save_match_history(winner, margin, margin_type);
-    display_scoreboard(0);
+    show_man_of_the_match(m);
+    save_match_history(m);
+    display_scoreboard(m, 0);
 
     printf("\nPRESS ANY KEY TO CONTINUE...");
     getch_silent();
 }
 
-void show_man_of_the_match(void) {
-    Player *best = NULL;
-    Team *best_team = NULL;
+void show_man_of_the_match(const MatchState* m) {
+    const Player *best = NULL;
+    const Team *best_team = NULL;
+    const char *best_name = NULL;
     float best_score = -1.0f;
 
     for (int t = 0; t < MAX_TEAMS; t++) {
-        for (int i = 0; i < teams[t].player_count; i++) {
-            Player *p = &teams[t].players[i];
+        for (int i = 0; i < m->teams[t].player_count; i++) {
+            const Player *p = &m->teams[t].players[i];
             float score = 0.0f;
 
             if (p->balls_faced > 0)
-                score += p->runs + p->strike_rate * 0.2f;
-
+                score += p->runs + player_strike_rate(p) * 0.2f;
+            
             if (p->is_bowler && p->balls_bowled > 0)
-                score += p->wickets * 25.0f - p->economy * 2.0f;
-
+                score += p->wickets * 25.0f - player_economy(p) * 2.0f;
+            
             if (score > best_score) {
                 best_score = score;
                 best = p;
-                best_team = &teams[t];
+                best_team = &m->teams[t];
+                best_name = m->teams[t].player_names[i];
             }
         }
     }
@@ -766,7 +2453,7 @@ void show_man_of_the_match(void) {
     printf(MAGENTA "\n╔════════════ MAN OF THE MATCH ═════════════╗\n");
 
     if (best && best_score > 0) {
-        printf("║  %s (%s)\n", best->name, best_team->name);
+        printf("║  %s (%s)\n", best_name, best_team->name);
         printf("║  RUNS: %d | WICKETS: %d\n", best->runs, best->wickets);
     } else {
         printf("║  No standout performance\n");
@@ -775,14 +2462,396 @@ void show_man_of_the_match(void) {
     printf("╚════════════════════════════════════════════╝\n" RESET);
 }
 
-void clear_screen(void) {
+/* Model row of every ball a side can face. The batsman on strike is the
+   one numbered by the wickets already down, and over o is bowled by the
+   (o mod bowlers)-th bowler, so both follow from the DP state. */
+static uint8_t outcome_plan_row(const MatchState* m, int team, int batsman, int over) {
+    int bowler_count = m->plan.bowler_count[1 - team];
+    
+    if (bowler_count == 0) return MATCHUP_NEUTRAL;
+    return m->matchup[team][batsman][m->plan.bowlers[1 - team][over % bowler_count]];
+}
+
+static void outcome_plan(const MatchState* m, int team, int overs, uint8_t* plan) {
+    for (int w = 0; w < MAX_PLAYERS; w++) {
+        for (int o = 0; o < overs; o++) plan[w * overs + o] = outcome_plan_row(m, team, w, o);
+    }
+}
+
+static const double* ball_outcome_probs(const WinProbTable* t, int team, int balls, int wickets) {
+    int overs = t->max_balls / 6;
+    int batsman = t->all_out[team] - wickets;
+    int over = (t->max_balls - balls) / 6;
+    
+    return t->model->p[t->plan[team][batsman * overs + over]];
+}
+
+static size_t chase_index(const WinProbTable* t, int team, int balls, int wickets, int need) {
+    return (size_t)(t->all_out[team] + 1) * (3 * (size_t)balls * balls - 2 * (size_t)balls) +
+           (size_t)wickets * (6 * balls + 1) + (size_t)(need - 1);
+}
+
+static size_t first_index(const WinProbTable* t, int team, int balls, int wickets, int runs) {
+    size_t width = 6 * (size_t)t->max_balls + 1;
+    return (size_t)(t->all_out[team] + 1) * ((size_t)balls * width - 3 * (size_t)balls * (balls - 1)) +
+           (size_t)wickets * (6 * (t->max_balls - balls) + 1) + (size_t)runs;
+}
+
+/* Chasing side's chances with `balls` left, `wickets` in hand and `need`
+   runs still required to win. */
+static WinTie chase_value(const WinProbTable* t, int team, int balls, int wickets, int need) {
+    WinTie v = {0.0f, 0.0f};
+    
+    if (need <= 0) {
+        v.win = 1.0f;
+    } else if (balls == 0 || wickets == 0) {
+        v.tie = need == 1 ? 1.0f : 0.0f;
+    } else if (need <= 6 * balls + 1) {
+        v = t->chase[team][chase_index(t, team, balls, wickets, need)];
+    }
+    return v;
+}
+
+/* Side batting first's chances after scoring `runs` with `balls` left and
+   `wickets` in hand. */
+static WinTie first_value(const WinProbTable* t, int team, int balls, int wickets, int runs) {
+    return t->first[team][first_index(t, team, balls, wickets, runs)];
+}
+
+WinProbTable* winprob_build(const MatchState* m) {
+    WinProbTable* t = (WinProbTable*)calloc(1, sizeof(WinProbTable));
+    if (!t) return NULL;
+    
+    int B = m->config.max_overs * 6;
+    t->max_balls = B;
+    t->model = m->model;
+    for (int team = 0; team < MAX_TEAMS; team++) {
+        t->all_out[team] = m->teams[team].player_count - 1;
+        if (t->all_out[team] < 0) t->all_out[team] = 0;
+        t->plan[team] = (uint8_t*)malloc((size_t)MAX_PLAYERS * m->config.max_overs + 1);
+        t->chase[team] = (WinTie*)malloc(chase_index(t, team, B + 1, 0, 1) * sizeof(WinTie));
+        t->first[team] = (WinTie*)malloc(first_index(t, team, B + 1, 0, 0) * sizeof(WinTie));
+        if (!t->plan[team] || !t->chase[team] || !t->first[team]) {
+            winprob_free(t);
+            return NULL;
+        }
+        outcome_plan(m, team, m->config.max_overs, t->plan[team]);
+    }
+    
+    for (int team = 0; team < MAX_TEAMS; team++) {
+        for (int b = 0; b <= B; b++) {
+            for (int w = 0; w <= t->all_out[team]; w++) {
+                const double* p = b > 0 && w > 0 ? ball_outcome_probs(t, team, b, w) : NULL;
+                
+                for (int need = 1; need <= 6 * b + 1; need++) {
+                    WinTie v = {0.0f, need == 1 ? 1.0f : 0.0f};
+                    
+                    if (p) {
+                        double win = 0.0, tie = 0.0;
+                        for (int k = 0; k < OUTCOMES; k++) {
+                            WinTie next = chase_value(t, team, b - 1, w - outcome_wicket[k],
+                                                      need - outcome_runs[k]);
+                            win += p[k] * next.win;
+                            tie += p[k] * next.tie;
+                        }
+                        v.win = (float)win;
+                        v.tie = (float)tie;
+                    }
+                    t->chase[team][chase_index(t, team, b, w, need)] = v;
+                }
+            }
+        }
+    }
+    
+    for (int team = 0; team < MAX_TEAMS; team++) {
+        int chaser = 1 - team;
+        
+        for (int b = 0; b <= B; b++) {
+            for (int w = 0; w <= t->all_out[team]; w++) {
+                const double* p = b > 0 && w > 0 ? ball_outcome_probs(t, team, b, w) : NULL;
+                
+                for (int r = 0; r <= 6 * (B - b); r++) {
+                    WinTie v;
+                    
+                    if (!p) {
+                        WinTie chase = chase_value(t, chaser, B, t->all_out[chaser], r + 1);
+                        v.win = 1.0f - chase.win - chase.tie;
+                        v.tie = chase.tie;
+                    } else {
+                        double win = 0.0, tie = 0.0;
+                        for (int k = 0; k < OUTCOMES; k++) {
+                            WinTie next = first_value(t, team, b - 1, w - outcome_wicket[k],
+                                                      r + outcome_runs[k]);
+                            win += p[k] * next.win;
+                            tie += p[k] * next.tie;
+                        }
+                        v.win = (float)win;
+                        v.tie = (float)tie;
+                    }
+                    t->first[team][first_index(t, team, b, w, r)] = v;
+                }
+            }
+        }
+    }
+    
+    return t;
+}
+
+void winprob_free(WinProbTable* t) {
+    if (!t) return;
+    for (int team = 0; team < MAX_TEAMS; team++) {
+        free(t->plan[team]);
+        free(t->chase[team]);
+        free(t->first[team]);
+    }
+    free(t);
+}
+
+static int winprob_matches(const WinProbTable* t, const MatchState* m) {
+    int overs = m->config.max_overs;
+    
+    if (t->max_balls != overs * 6 || t->model != m->model) {
+        return 0;
+    }
+    for (int team = 0; team < MAX_TEAMS; team++) {
+        int all_out = m->teams[team].player_count - 1;
+        if (t->all_out[team] != (all_out < 0 ? 0 : all_out)) return 0;
+    }
+    
+    /* Called on every scoreboard, so the plan is compared row by row
+       rather than rebuilt into a buffer. */
+    for (int team = 0; team < MAX_TEAMS; team++) {
+        for (int w = 0; w < MAX_PLAYERS; w++) {
+            for (int o = 0; o < overs; o++) {
+                if (t->plan[team][w * overs + o] != outcome_plan_row(m, team, w, o)) return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Win/tie chances for both sides at the current point of the match. */
+void winprob_query(const WinProbTable* t, const MatchState* m, float win[MAX_TEAMS], float* tie) {
+    int bat = m->currently_batting;
+    const Team* batting = &m->teams[bat];
+    int balls = t->max_balls - batting->total_balls;
+    int wickets = t->all_out[bat] - batting->total_wickets;
+    WinTie v;
+    
+    if (balls < 0) balls = 0;
+    if (wickets < 0) wickets = 0;
+    
+    if (m->match_over || !m->first_innings) {
+        v = chase_value(t, bat, balls, wickets, m->teams[1 - bat].total_runs + 1 - batting->total_runs);
+    } else {
+        v = first_value(t, bat, balls, wickets, batting->total_runs);
+    }
+    
+    win[bat] = v.win;
+    win[1 - bat] = 1.0f - v.win - v.tie;
+    *tie = v.tie;
+}
+
+/* Table for the interactive match, rebuilt only when the format, outcome
+   model, squad sizes or who bats and bowls when change. */
+const WinProbTable* winprob_for(const MatchState* m) {
+    static WinProbTable* cached = NULL;
+    
+    if (cached && winprob_matches(cached, m)) return cached;
+    
+    winprob_free(cached);
+    cached = winprob_build(m);
+    return cached;
+}
+
+static const char* pen_codes[] = {RESET, RED, GREEN, YELLOW, BLUE, MAGENTA, CYAN, WHITE};
+
+/* Everything the renderer sends goes out through here, after anything
+   still buffered in stdout so the two streams stay in order. */
+static void screen_write(const char* data, size_t len) {
+    fflush(stdout);
 #ifdef _WIN32
-    system("cls");
+    fwrite(data, 1, len, stdout);
+    fflush(stdout);
 #else
-    system("clear");
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, len);
+        if (n <= 0) return;
+        data += n;
+        len -= (size_t)n;
+    }
 #endif
 }
 
+static void screen_emit(Screen* s, const char* data, size_t len) {
+    if (s->out_len + len > sizeof(s->out)) {
+        screen_write(s->out, s->out_len);
+        s->out_len = 0;
+    }
+    memcpy(s->out + s->out_len, data, len);
+    s->out_len += len;
+}
+
+static void screen_emit_glyph(Screen* s, uint32_t c) {
+    char bytes[4];
+    size_t n;
+    
+    if (c < 0x80) {
+        bytes[0] = (char)c;
+        n = 1;
+    } else if (c < 0x800) {
+        bytes[0] = (char)(0xC0 | (c >> 6));
+        bytes[1] = (char)(0x80 | (c & 0x3F));
+        n = 2;
+    } else if (c < 0x10000) {
+        bytes[0] = (char)(0xE0 | (c >> 12));
+        bytes[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+        bytes[2] = (char)(0x80 | (c & 0x3F));
+        n = 3;
+    } else {
+        bytes[0] = (char)(0xF0 | (c >> 18));
+        bytes[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+        bytes[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+        bytes[3] = (char)(0x80 | (c & 0x3F));
+        n = 4;
+    }
+    screen_emit(s, bytes, n);
+}
+
+/* A zero cell is blank, and every row from `height` down is blank, so
+   only the rows in use need clearing. */
+static void frame_clear(Frame* f) {
+    memset(f->glyph, 0, (size_t)f->height * sizeof(f->glyph[0]));
+    memset(f->pen, 0, (size_t)f->height * sizeof(f->pen[0]));
+    f->height = 0;
+}
+
+/* Starts a new frame in the back buffer. */
+void screen_begin(Screen* s) {
+    frame_clear(&s->back);
+    s->row = 0;
+    s->col = 0;
+}
+
+/* printf into the back buffer. Text past the frame's edges is dropped. */
+void screen_printf(Screen* s, Pen pen, const char* format, ...) {
+    char text[512];
+    va_list args;
+    
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    
+    const unsigned char* p = (const unsigned char*)text;
+    while (*p) {
+        uint32_t c = *p++;
+        if (c >= 0xC0) {
+            int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : 1;
+            c &= 0x3F >> extra;
+            while (extra-- > 0 && (*p & 0xC0) == 0x80) c = (c << 6) | (*p++ & 0x3F);
+        }
+        if (c == '\n') {
+            s->row++;
+            s->col = 0;
+            continue;
+        }
+        if (s->row < SCREEN_ROWS && s->col < SCREEN_COLS) {
+            s->back.glyph[s->row][s->col] = c == ' ' ? 0 : c;
+            s->back.pen[s->row][s->col] = (uint8_t)(c == ' ' ? PEN_DEFAULT : pen);
+            if (s->row >= s->back.height) s->back.height = s->row + 1;
+        }
+        s->col++;
+    }
+}
+
+/* The next present repaints the whole frame, for when anything else has
+   been printed over it. */
+void screen_invalidate(Screen* s) {
+    s->front_valid = 0;
+}
+
+/* Writes only the cells that differ from what is on the terminal, in one
+   write(). A full repaint clears the screen in the same write, so nothing
+   blank is ever shown in between. The cursor is left under the frame. */
+void screen_present(Screen* s) {
+    char seq[32];
+    int pen = -1;
+    int at_row = -1, at_col = -1;
+    STATS_START(start);
+    
+    s->out_len = 0;
+    if (!s->front_valid) {
+        screen_emit(s, "\033[H\033[2J", 7);
+        frame_clear(&s->front);
+        s->front_valid = 1;
+    }
+    
+    int height = s->back.height > s->front.height ? s->back.height : s->front.height;
+    for (int r = 0; r < height; r++) {
+        if (memcmp(s->back.glyph[r], s->front.glyph[r], sizeof(s->back.glyph[r])) == 0 &&
+            memcmp(s->back.pen[r], s->front.pen[r], sizeof(s->back.pen[r])) == 0) {
+            continue;
+        }
+        for (int c = 0; c < SCREEN_COLS; c++) {
+            if (s->back.glyph[r][c] == s->front.glyph[r][c] &&
+                s->back.pen[r][c] == s->front.pen[r][c]) {
+                continue;
+            }
+            if (r != at_row || c != at_col) {
+                int n = snprintf(seq, sizeof(seq), "\033[%d;%dH", r + 1, c + 1);
+                screen_emit(s, seq, (size_t)n);
+            }
+            if (s->back.pen[r][c] != pen) {
+                pen = s->back.pen[r][c];
+                screen_emit(s, pen_codes[pen], strlen(pen_codes[pen]));
+            }
+            screen_emit_glyph(s, s->back.glyph[r][c] ? s->back.glyph[r][c] : ' ');
+            at_row = r;
+            at_col = c + 1;
+        }
+    }
+    
+    int n = snprintf(seq, sizeof(seq), "%s\033[%d;1H\033[J", RESET, s->back.height + 1);
+    screen_emit(s, seq, (size_t)n);
+    screen_write(s->out, s->out_len);
+    s->out_len = 0;
+    memcpy(s->front.glyph, s->back.glyph, (size_t)height * sizeof(s->back.glyph[0]));
+    memcpy(s->front.pen, s->back.pen, (size_t)height * sizeof(s->back.pen[0]));
+    s->front.height = s->back.height;
+    STATS_STOP(PHASE_PRESENT, start);
+}
+
+/* Prints the back buffer as ordinary lines at the cursor, for a frame
+   that is part of a longer report rather than a screen of its own. */
+void screen_print_inline(Screen* s) {
+    STATS_START(start);
+    
+    s->out_len = 0;
+    for (int r = 0; r < s->back.height; r++) {
+        int end = SCREEN_COLS;
+        int pen = PEN_DEFAULT;
+        while (end > 0 && s->back.glyph[r][end - 1] == 0) end--;
+        for (int c = 0; c < end; c++) {
+            if (s->back.pen[r][c] != pen) {
+                pen = s->back.pen[r][c];
+                screen_emit(s, pen_codes[pen], strlen(pen_codes[pen]));
+            }
+            screen_emit_glyph(s, s->back.glyph[r][c] ? s->back.glyph[r][c] : ' ');
+        }
+        if (pen != PEN_DEFAULT) screen_emit(s, RESET, strlen(RESET));
+        screen_emit(s, "\n", 1);
+    }
+    screen_write(s->out, s->out_len);
+    s->out_len = 0;
+    s->front_valid = 0;
+    STATS_STOP(PHASE_PRESENT, start);
+}
+
+void clear_screen(void) {
+    screen_write("\033[H\033[2J", 7);
+    screen_invalidate(&screen);
+}
+
 void safe_input(char* buffer, int size, const char* prompt) {
     printf("%s", prompt);
     if (fgets(buffer, size, stdin) != NULL) {
@@ -815,50 +2884,5619 @@ float calculate_economy(int runs, float overs) {
     return overs > 0 ? runs / overs : 0.0f;
 }
 
+float player_strike_rate(const Player* p) {
+    return calculate_strike_rate(p->runs, p->balls_faced);
+}
+
+/* Overs in the usual "4.3" notation: completed overs, then balls. */
+float player_overs(const Player* p) {
+    return p->balls_bowled / 6 + (p->balls_bowled % 6) / 10.0f;
+}
+
+float player_economy(const Player* p) {
+    return calculate_economy(p->runs_conceded, player_overs(p));
+}
+
+float team_run_rate(const Team* t) {
+    return calculate_economy(t->total_runs, t->total_balls / 6.0f);
+}
+
 int load_game_data(void) {
-    FILE* file = fopen("cricket_users.dat", "rb");
-    if (!file) return 0;
-    
-    int count = 0;
-    fread(&count, sizeof(int), 1, file);
-    if (count > 0 && count <= MAX_USERS) {
-        fread(users, sizeof(User), count, file);
-    }
-    
-    fclose(file);
-    return count;
+    STATS_START(start);
+    int ok = user_store_open(&user_store);
+    STATS_STOP(PHASE_LOAD, start);
+    return ok;
 }
 
+/* Accounts are written as they sign up, so for them this only pushes out
+   buffered data. The squads and any paused match go to SAVE_FILE. */
 void save_game_data(void) {
-    FILE* file = fopen("cricket_users.dat", "wb");
-    if (!file) {
+    STATS_START(start);
+    if ((user_store.records && fflush(user_store.records) != 0) || !save_game_file()) {
         printf(RED "Error saving game data!\n" RESET);
-        return;
     }
-    
-    fwrite(&user_count, sizeof(int), 1, file);
-    fwrite(users, sizeof(User), user_count, file);
-    
-    fclose(file);
+    STATS_STOP(PHASE_SAVE, start);
 }
 
-void cleanup_and_exit(void) {
-    printf(CYAN "\nTHANKS FOR PLAYING CRICKET SIMULATOR!\n" RESET);
+/* FNV-1a; the index keeps these 32 bits per slot so most probes never
+   touch the record file. */
+static uint32_t username_hash(const char* name) {
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+    return h;
 }
-void save_match_history(Team *winner, int margin, const char *type) {
-    FILE *fp = fopen("history.txt", "a");
-    if (!fp) return;
 
-    time_t now = time(NULL);
-    fprintf(fp, "Date: %s", ctime(&now));
-    fprintf(fp, "%s vs %s\n", teams[0].name, teams[1].name);
+static UserIndexHeader* user_index_header(const UserStore* s) {
+    return (UserIndexHeader*)s->index.data;
+}
 
-    if (winner)
-        fprintf(fp, "Winner: %s\nMargin: %d %s\n",
-                winner->name, margin, type);
-    else
-        fprintf(fp, "Result: Match Tied\n");
+static UserSlot* user_index_slots(const UserStore* s) {
+    return (UserSlot*)((char*)s->index.data + sizeof(UserIndexHeader));
+}
 
-    fprintf(fp, "----------------------------------\n\n");
-    fclose(fp);
+static void user_slot_insert(UserSlot* slots, uint32_t capacity, uint32_t tag, uint32_t record) {
+    uint32_t i = tag & (capacity - 1);
+    while (slots[i].record != 0) {
+        i = (i + 1) & (capacity - 1);
+    }
+    slots[i].tag = tag;
+    slots[i].record = record + 1;
+}
+
+static int user_read(UserStore* s, uint32_t record, User* user) {
+    long offset = (long)sizeof(UserFileHeader) + (long)record * (long)sizeof(User);
+    return fseek(s->records, offset, SEEK_SET) == 0 && fread(user, sizeof(User), 1, s->records) == 1;
+}
+
+/* Writes a fresh index with the given capacity next to the old one and
+   swaps it in. Entries are carried over from the old index when it is
+   valid (growth); otherwise the new index starts empty and is filled by
+   user_index_catch_up(). */
+static int user_index_rebuild(UserStore* s, uint32_t capacity, int keep_entries) {
+    MappedFile fresh;
+    size_t size = sizeof(UserIndexHeader) + (size_t)capacity * sizeof(UserSlot);
+
+    remove(USER_INDEX_TMP);
+    if (!map_file(&fresh, USER_INDEX_TMP, size)) return 0;
+
+    UserIndexHeader* header = (UserIndexHeader*)fresh.data;
+    UserSlot* slots = (UserSlot*)((char*)fresh.data + sizeof(UserIndexHeader));
+    memset(fresh.data, 0, size);
+    header->magic = USER_INDEX_MAGIC;
+    header->capacity = capacity;
+
+    if (keep_entries && s->index.data) {
+        UserIndexHeader* old = user_index_header(s);
+        UserSlot* old_slots = user_index_slots(s);
+        for (uint32_t i = 0; i < old->capacity; i++) {
+            if (old_slots[i].record != 0) {
+                user_slot_insert(slots, capacity, old_slots[i].tag, old_slots[i].record - 1);
+            }
+        }
+        header->count = old->count;
+    }
+
+    unmap_file(&s->index);
+    unmap_file(&fresh);
+#ifdef _WIN32
+    remove(USER_INDEX_FILE);
+#endif
+    if (rename(USER_INDEX_TMP, USER_INDEX_FILE) != 0) return 0;
+    return map_file(&s->index, USER_INDEX_FILE, 0);
+}
+
+static int user_index_add(UserStore* s, uint32_t tag, uint32_t record) {
+    UserIndexHeader* header = user_index_header(s);
+
+    if ((header->count + 1) * 2 > header->capacity) {
+        if (!user_index_rebuild(s, header->capacity * 2, 1)) return 0;
+        header = user_index_header(s);
+    }
+    user_slot_insert(user_index_slots(s), header->capacity, tag, record);
+    header->count = record + 1;
+    return 1;
+}
+
+/* Indexes records appended after the index was last written, e.g. when
+   the program stopped between the two writes of a signup. */
+static int user_index_catch_up(UserStore* s) {
+    uint32_t record = user_index_header(s)->count;
+    User user;
+
+    if (record >= s->record_count) return 1;
+    if (fseek(s->records, (long)sizeof(UserFileHeader) + (long)record * (long)sizeof(User), SEEK_SET) != 0) {
+        return 0;
+    }
+    for (; record < s->record_count; record++) {
+        if (fread(&user, sizeof(User), 1, s->records) != 1) return 0;
+        user.username[MAX_USERNAME - 1] = '\0';
+        if (!user_index_add(s, username_hash(user.username), record)) return 0;
+    }
+    return 1;
+}
+
+static int user_index_valid(const UserStore* s) {
+    const UserIndexHeader* header = user_index_header(s);
+    return s->index.size >= sizeof(UserIndexHeader) &&
+           header->magic == USER_INDEX_MAGIC &&
+           header->capacity >= USER_INDEX_MIN &&
+           (header->capacity & (header->capacity - 1)) == 0 &&
+           s->index.size == sizeof(UserIndexHeader) + (size_t)header->capacity * sizeof(UserSlot) &&
+           header->count <= s->record_count;
+}
+
+/* Rewrites a pre-index users file ([int count][User...]) in the current
+   format. */
+static int user_store_migrate(FILE* old) {
+    FILE* fresh = fopen(USER_FILE_TMP, "wb");
+    UserFileHeader header = {USER_MAGIC, USER_FILE_VERSION, (uint32_t)sizeof(User), 0};
+    User user;
+    int count = 0;
+
+    if (!fresh) return 0;
+    rewind(old);
+    int ok = fwrite(&header, sizeof(header), 1, fresh) == 1;
+    if (ok && fread(&count, sizeof(int), 1, old) == 1) {
+        for (int i = 0; ok && i < count && fread(&user, sizeof(User), 1, old) == 1; i++) {
+            ok = fwrite(&user, sizeof(User), 1, fresh) == 1;
+        }
+    }
+    if (fclose(fresh) != 0) ok = 0;
+    fclose(old);
+
+    if (ok) {
+#ifdef _WIN32
+        remove(USER_FILE);
+#endif
+        ok = rename(USER_FILE_TMP, USER_FILE) == 0;
+        remove(USER_INDEX_FILE);
+    }
+    if (!ok) remove(USER_FILE_TMP);
+    return ok;
+}
+
+int user_store_open(UserStore* s) {
+    UserFileHeader header;
+
+    memset(s, 0, sizeof(*s));
+    s->records = fopen(USER_FILE, "r+b");
+    if (s->records && (fread(&header, sizeof(header), 1, s->records) != 1 || header.magic != USER_MAGIC)) {
+        if (!user_store_migrate(s->records)) {
+            s->records = NULL;
+            return 0;
+        }
+        s->records = fopen(USER_FILE, "r+b");
+    } else if (!s->records) {
+        UserFileHeader fresh = {USER_MAGIC, USER_FILE_VERSION, (uint32_t)sizeof(User), 0};
+        s->records = fopen(USER_FILE, "w+b");
+        if (s->records && fwrite(&fresh, sizeof(fresh), 1, s->records) != 1) {
+            fclose(s->records);
+            s->records = NULL;
+        }
+    }
+    if (!s->records) return 0;
+    rewind(s->records);
+    if (fread(&header, sizeof(header), 1, s->records) != 1 || header.record_size != sizeof(User)) {
+        user_store_close(s);
+        return 0;
+    }
+    
+    fseek(s->records, 0, SEEK_END);
+    long size = ftell(s->records);
+    s->record_count = size > (long)sizeof(UserFileHeader)
+                      ? (uint32_t)((size - (long)sizeof(UserFileHeader)) / (long)sizeof(User)) : 0;
+
+    if (!map_file(&s->index, USER_INDEX_FILE, 0) || !user_index_valid(s)) {
+        uint32_t capacity = USER_INDEX_MIN;
+        while (capacity < s->record_count * 2) capacity *= 2;
+        if (!user_index_rebuild(s, capacity, 0)) {
+            user_store_close(s);
+            return 0;
+        }
+    }
+    if (!user_index_catch_up(s)) {
+        user_store_close(s);
+        return 0;
+    }
+    return 1;
+}
+
+void user_store_close(UserStore* s) {
+    unmap_file(&s->index);
+    if (s->records) fclose(s->records);
+    s->records = NULL;
+}
+
+/* Returns the record number of username and fills *user, or -1. */
+long user_store_find(UserStore* s, const char* username, User* user) {
+    if (!s->index.data) return -1;
+
+    uint32_t tag = username_hash(username);
+    uint32_t capacity = user_index_header(s)->capacity;
+    UserSlot* slots = user_index_slots(s);
+
+    for (uint32_t i = tag & (capacity - 1); slots[i].record != 0; i = (i + 1) & (capacity - 1)) {
+        if (slots[i].tag == tag && user_read(s, slots[i].record - 1, user) &&
+            strncmp(user->username, username, MAX_USERNAME) == 0) {
+            return (long)slots[i].record - 1;
+        }
+    }
+    return -1;
+}
+
+/* The record is appended and flushed before the index points at it. */
+int user_store_add(UserStore* s, const User* user) {
+    if (!s->index.data) return 0;
+    if (fseek(s->records, 0, SEEK_END) != 0 ||
+        fwrite(user, sizeof(User), 1, s->records) != 1 ||
+        fflush(s->records) != 0) {
+        return 0;
+    }
+    return user_index_add(s, username_hash(user->username), s->record_count++);
+}
+
+void cleanup_and_exit(void) {
+    save_game_data();
+    user_store_close(&user_store);
+    pool_destroy(game_pool);
+    game_pool = NULL;
+    if (history_open) {
+        log_block_free(&match_events);
+        event_log_close(&history);
+        history_open = 0;
+    }
+    printf(CYAN "\nTHANKS FOR PLAYING CRICKET SIMULATOR!\n" RESET);
+}
+void save_match_history(const MatchState* m) {
+    if (!history_open) return;
+    
+    STATS_START(start);
+    log_end_match(&match_events, m);
+    int saved = log_block_flush(&match_events);
+    STATS_STOP(PHASE_HISTORY, start);
+    if (saved) {
+        printf(CYAN "MATCH %u SAVED. REPLAY IT WITH --replay %u\n" RESET, history.next_match, history.next_match);
+        history.next_match++;
+    }
+}
+
+/* CRC-32 (IEEE), eight bytes per step using the slicing-by-8 tables. */
+static uint32_t crc_table[8][256];
+
+static void crc32_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            crc_table[t][i] = crc_table[0][crc_table[t - 1][i] & 0xff] ^ (crc_table[t - 1][i] >> 8);
+        }
+    }
+}
+
+static uint32_t log_crc32(const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    uint32_t c = 0xffffffffu;
+
+    while (len >= 8) {
+        uint32_t lo = c ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        uint32_t hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+        c = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^
+            crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24] ^
+            crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff] ^
+            crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        c = crc_table[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+    }
+    return c ^ 0xffffffffu;
+}
+
+static FILE* open_log_file(const char* base, const char* ext, const char* mode) {
+    char path[FILENAME_MAX];
+    snprintf(path, sizeof(path), "%s.%s", base, ext);
+    return fopen(path, mode);
+}
+
+static int roster_cache_add(EventLog* log, const RosterRecord* r) {
+    if (log->roster_count == log->roster_capacity) {
+        int capacity = log->roster_capacity ? log->roster_capacity * 2 : 16;
+        RosterRecord* grown = (RosterRecord*)realloc(log->roster_cache, capacity * sizeof(RosterRecord));
+        if (!grown) return 0;
+        log->roster_cache = grown;
+        log->roster_capacity = capacity;
+    }
+    log->roster_cache[log->roster_count++] = *r;
+    return 1;
+}
+
+/* Writes the blocks of tickets [first, last) as one group commit: every
+   block into BASE.bin, one flush, then their index entries into BASE.idx
+   and one more flush, so an index entry never refers to a block that is
+   not fully written. Returns the number of matches written. */
+static long log_write_group(EventLog* log, uint64_t first, uint64_t last) {
+    int ok = !__atomic_load_n(&log->failed, __ATOMIC_RELAXED);
+    long matches = 0;
+    
+    for (uint64_t t = first; ok && t < last; t++) {
+        WriterSlot* s = &log->slots[t % WRITER_SLOTS];
+        LogBlockHeader header;
+        if (s->count == 0) continue;
+        
+        header.magic = LOG_MAGIC;
+        header.count = s->count;
+        header.crc = log_crc32(s->records, s->count * sizeof(BallRecord));
+        header.first_match = s->first_match;
+        for (uint32_t i = 0; i < s->match_count; i++) {
+            s->matches[i].block_offset = log->data_end;
+        }
+        ok = fwrite(&header, sizeof(header), 1, log->data) == 1 &&
+             fwrite(s->records, sizeof(BallRecord), s->count, log->data) == s->count;
+        log->data_end += sizeof(header) + s->count * sizeof(BallRecord);
+    }
+    ok = ok && fflush(log->data) == 0;
+    for (uint64_t t = first; ok && t < last; t++) {
+        WriterSlot* s = &log->slots[t % WRITER_SLOTS];
+        ok = fwrite(s->matches, sizeof(MatchIndexEntry), s->match_count, log->index) == s->match_count;
+        matches += s->match_count;
+    }
+    ok = ok && fflush(log->index) == 0;
+    
+    if (!ok) __atomic_store_n(&log->failed, 1, __ATOMIC_RELAXED);
+    return matches;
+}
+
+static void log_sync_files(EventLog* log) {
+    mutex_lock(&log->lock);
+    if (!file_sync(log->rosters) || !file_sync(log->data) || !file_sync(log->index)) {
+        __atomic_store_n(&log->failed, 1, __ATOMIC_RELAXED);
+    }
+    mutex_unlock(&log->lock);
+}
+
+/* Drains the ring in order, writing whatever is ready as one group, and
+   syncs when the policy says so. With nothing to write it sleeps, waking
+   on the next block, a sync that falls due, or event_log_close(). */
+static THREAD_RETURN log_writer_thread(void* arg) {
+    EventLog* log = (EventLog*)arg;
+    uint64_t tail = 0;
+    long unsynced = 0;
+    double last_sync = now_seconds();
+    double spin = cpu_count() > 1 ? WRITER_SPIN : 0.0;
+    
+    for (;;) {
+        uint64_t end = tail;
+        int wrote;
+        while (end - tail < WRITER_SLOTS &&
+               __atomic_load_n(&log->slots[end % WRITER_SLOTS].sequence, __ATOMIC_ACQUIRE) == end + 1) {
+            end++;
+        }
+        wrote = end > tail;
+        if (wrote) {
+            unsynced += log_write_group(log, tail, end);
+            for (; tail < end; tail++) {
+                __atomic_store_n(&log->slots[tail % WRITER_SLOTS].sequence, tail + WRITER_SLOTS,
+                                 __ATOMIC_SEQ_CST);
+            }
+            if (__atomic_load_n(&log->waiting, __ATOMIC_SEQ_CST)) {
+                mutex_lock(&log->wait_lock);
+                cond_broadcast(&log->drained);
+                mutex_unlock(&log->wait_lock);
+            }
+        }
+        
+        double since_sync = (now_seconds() - last_sync) * 1000.0;
+        if (unsynced > 0 && ((log->sync_matches > 0 && unsynced >= log->sync_matches) ||
+                             (log->sync_ms > 0 && since_sync >= log->sync_ms))) {
+            log_sync_files(log);
+            unsynced = 0;
+            last_sync = now_seconds();
+            since_sync = 0.0;
+        }
+        if (wrote) continue;
+        
+        /* Blocks come in bursts, so a short spin usually finds the next
+           one and saves its producer a wakeup. Pointless on one core. */
+        double spin_end = now_seconds() + spin;
+        while (now_seconds() < spin_end &&
+               __atomic_load_n(&log->slots[tail % WRITER_SLOTS].sequence, __ATOMIC_ACQUIRE) != tail + 1) {}
+        if (__atomic_load_n(&log->slots[tail % WRITER_SLOTS].sequence, __ATOMIC_ACQUIRE) == tail + 1) continue;
+        
+        mutex_lock(&log->wait_lock);
+        __atomic_store_n(&log->writer_idle, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&log->slots[tail % WRITER_SLOTS].sequence, __ATOMIC_SEQ_CST) != tail + 1) {
+            if (log->stopping) {
+                mutex_unlock(&log->wait_lock);
+                break;
+            }
+            if (unsynced > 0 && log->sync_ms > 0) {
+                cond_wait_ms(&log->wake, &log->wait_lock, (int)(log->sync_ms - since_sync) + 1);
+            } else {
+                cond_wait(&log->wake, &log->wait_lock);
+            }
+        }
+        __atomic_store_n(&log->writer_idle, 0, __ATOMIC_SEQ_CST);
+        mutex_unlock(&log->wait_lock);
+    }
+    
+    if (unsynced > 0 && (log->sync_matches > 0 || log->sync_ms > 0)) log_sync_files(log);
+    return THREAD_RESULT;
+}
+
+int event_log_open(EventLog* log, const char* base) {
+    memset(log, 0, sizeof(*log));
+    mutex_init(&log->lock);
+    mutex_init(&log->wait_lock);
+    cond_init(&log->wake);
+    cond_init(&log->drained);
+    for (int i = 0; i < WRITER_SLOTS; i++) log->slots[i].sequence = (uint64_t)i;
+    log->sync_matches = log_sync_matches;
+    log->sync_ms = log_sync_ms;
+    crc32_init();
+
+    log->data = open_log_file(base, "bin", "ab");
+    log->index = open_log_file(base, "idx", "ab");
+    log->rosters = open_log_file(base, "rosters", "a+b");
+    if (!log->data || !log->index || !log->rosters) {
+        event_log_close(log);
+        return 0;
+    }
+
+    fseek(log->data, 0, SEEK_END);
+    log->data_end = (uint64_t)ftell(log->data);
+    fseek(log->index, 0, SEEK_END);
+    log->next_match = (uint32_t)(ftell(log->index) / (long)sizeof(MatchIndexEntry));
+
+    RosterRecord r;
+    rewind(log->rosters);
+    while (fread(&r, sizeof(r), 1, log->rosters) == 1) {
+        if (!roster_cache_add(log, &r)) break;
+    }
+    
+    if (!thread_create(&log->writer, log_writer_thread, log)) {
+        event_log_close(log);
+        return 0;
+    }
+    log->writer_running = 1;
+    return 1;
+}
+
+/* Waits for the writer to finish every block handed to it, then closes
+   the files. */
+void event_log_close(EventLog* log) {
+    if (log->writer_running) {
+        mutex_lock(&log->wait_lock);
+        log->stopping = 1;
+        cond_broadcast(&log->wake);
+        mutex_unlock(&log->wait_lock);
+        thread_join(log->writer);
+    }
+    for (int i = 0; i < WRITER_SLOTS; i++) {
+        free(log->slots[i].records);
+        free(log->slots[i].matches);
+    }
+    mutex_destroy(&log->wait_lock);
+    cond_destroy(&log->wake);
+    cond_destroy(&log->drained);
+    if (log->data) fclose(log->data);
+    if (log->index) fclose(log->index);
+    if (log->rosters) fclose(log->rosters);
+    free(log->roster_cache);
+    mutex_destroy(&log->lock);
+    memset(log, 0, sizeof(*log));
+}
+
+/* Returns the id of the squad in BASE.rosters, appending it the first
+   time this exact squad is seen. */
+uint32_t event_log_roster(EventLog* log, const Team* team) {
+    RosterRecord r;
+    uint32_t id;
+
+    memset(&r, 0, sizeof(r));
+    copy_name(r.team_name, team->name);
+    r.player_count = (uint8_t)team->player_count;
+    for (int i = 0; i < team->player_count; i++) {
+        copy_name(r.players[i], team->player_names[i]);
+        r.is_bowler[i] = team->players[i].is_bowler ? 1 : 0;
+    }
+
+    mutex_lock(&log->lock);
+    for (id = 0; id < (uint32_t)log->roster_count; id++) {
+        if (memcmp(&log->roster_cache[id], &r, sizeof(r)) == 0) {
+            mutex_unlock(&log->lock);
+            return id;
+        }
+    }
+    if (!roster_cache_add(log, &r) || fwrite(&r, sizeof(r), 1, log->rosters) != 1) {
+        __atomic_store_n(&log->failed, 1, __ATOMIC_RELAXED);
+        mutex_unlock(&log->lock);
+        return UINT32_MAX;
+    }
+    fflush(log->rosters);
+    mutex_unlock(&log->lock);
+    return id;
+}
+
+/* A block always has room for a whole match, so no match spans two blocks. */
+int log_block_init(LogBlock* b, EventLog* log, int max_overs) {
+    memset(b, 0, sizeof(*b));
+    b->log = log;
+    b->capacity = LOG_BLOCK_RECORDS;
+    if (max_overs * 12 > LOG_BLOCK_RECORDS) b->capacity = (uint32_t)max_overs * 12;
+    b->records = (BallRecord*)malloc(b->capacity * sizeof(BallRecord));
+    b->matches = (MatchIndexEntry*)malloc(b->capacity * sizeof(MatchIndexEntry));
+    if (!b->records || !b->matches) {
+        log_block_free(b);
+        return 0;
+    }
+    return 1;
+}
+
+void log_block_free(LogBlock* b) {
+    free(b->records);
+    free(b->matches);
+    b->records = NULL;
+    b->matches = NULL;
+}
+
+void log_begin_match(LogBlock* b, uint32_t match_id, const MatchState* m) {
+    if (b->capacity - b->count < (uint32_t)m->config.max_overs * 12) {
+        log_block_flush(b);
+    }
+    b->match_id = match_id;
+    b->first_record = b->count;
+    b->batting_first = m->currently_batting;
+}
+
+static void fill_ball_record(BallRecord* rec, uint32_t match_id, int innings, int ball, const BallResult* r) {
+    rec->match_id = match_id;
+    rec->ball = (uint16_t)ball;
+    rec->innings = (uint8_t)innings;
+    rec->batsman = (uint8_t)r->batsman;
+    rec->bowler = (uint8_t)r->bowler;
+    rec->runs = (uint8_t)r->runs;
+    rec->wicket = (uint8_t)r->is_wicket;
+    rec->pad = 0;
+}
+
+void log_ball(LogBlock* b, int innings, int ball, const BallResult* r) {
+    fill_ball_record(&b->records[b->count++], b->match_id, innings, ball, r);
+}
+
+void log_end_match(LogBlock* b, const MatchState* m) {
+    MatchIndexEntry* e = &b->matches[b->match_count++];
+    char margin_type[20];
+    int margin = 0;
+    int winner = decide_match_result(m, &margin, margin_type);
+
+    memset(e, 0, sizeof(*e));
+    e->timestamp = (int64_t)time(NULL);
+    e->match_id = b->match_id;
+    e->first_record = b->first_record;
+    e->ball_count = b->count - b->first_record;
+    e->max_overs = (uint16_t)m->config.max_overs;
+    e->margin = (uint16_t)margin;
+    e->winner = (int8_t)winner;
+    e->batting_first = (uint8_t)b->batting_first;
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        e->roster[t] = b->roster[t];
+        e->runs[t] = (uint16_t)m->teams[t].total_runs;
+        e->wickets[t] = (uint8_t)m->teams[t].total_wickets;
+    }
+}
+
+static int writer_slot_reserve(WriterSlot* s, uint32_t records, uint32_t matches) {
+    if (records > s->records_capacity) {
+        BallRecord* grown = (BallRecord*)realloc(s->records, records * sizeof(BallRecord));
+        if (!grown) return 0;
+        s->records = grown;
+        s->records_capacity = records;
+    }
+    if (matches > s->matches_capacity) {
+        MatchIndexEntry* grown = (MatchIndexEntry*)realloc(s->matches, matches * sizeof(MatchIndexEntry));
+        if (!grown) return 0;
+        s->matches = grown;
+        s->matches_capacity = matches;
+    }
+    return 1;
+}
+
+/* Hands the buffered balls to the writer thread. A producer claims a
+   ticket with a compare-and-swap and copies the block into that ticket's
+   slot, so nothing here locks unless the ring is full or the writer has
+   to be woken. Returns 0 once the log has failed. */
+int log_block_flush(LogBlock* b) {
+    EventLog* log = b->log;
+    uint64_t ticket = __atomic_load_n(&log->head, __ATOMIC_RELAXED);
+    WriterSlot* s;
+    
+    if (b->count == 0) return 1;
+    
+    for (;;) {
+        s = &log->slots[ticket % WRITER_SLOTS];
+        int64_t lag = (int64_t)(__atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE) - ticket);
+        if (lag == 0) {
+            if (__atomic_compare_exchange_n(&log->head, &ticket, ticket + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (lag < 0) {
+            mutex_lock(&log->wait_lock);
+            __atomic_add_fetch(&log->waiting, 1, __ATOMIC_SEQ_CST);
+            while ((int64_t)(__atomic_load_n(&s->sequence, __ATOMIC_SEQ_CST) - ticket) < 0) {
+                cond_wait(&log->drained, &log->wait_lock);
+            }
+            __atomic_sub_fetch(&log->waiting, 1, __ATOMIC_SEQ_CST);
+            mutex_unlock(&log->wait_lock);
+            ticket = __atomic_load_n(&log->head, __ATOMIC_RELAXED);
+        } else {
+            ticket = __atomic_load_n(&log->head, __ATOMIC_RELAXED);
+        }
+    }
+    
+    if (writer_slot_reserve(s, b->count, b->match_count)) {
+        memcpy(s->records, b->records, b->count * sizeof(BallRecord));
+        memcpy(s->matches, b->matches, b->match_count * sizeof(MatchIndexEntry));
+        s->count = b->count;
+        s->match_count = b->match_count;
+        s->first_match = b->match_count ? b->matches[0].match_id : b->match_id;
+    } else {
+        s->count = 0;
+        s->match_count = 0;
+        __atomic_store_n(&log->failed, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&s->sequence, ticket + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&log->writer_idle, __ATOMIC_SEQ_CST)) {
+        mutex_lock(&log->wait_lock);
+        cond_broadcast(&log->wake);
+        mutex_unlock(&log->wait_lock);
+    }
+    
+    b->count = 0;
+    b->match_count = 0;
+    return !__atomic_load_n(&log->failed, __ATOMIC_RELAXED);
+}
+
+/* Reads BASE.bin block by block, verifying every checksum, and checks the
+   totals against BASE.idx. */
+int run_log_scan(const char* base) {
+    FILE* data = open_log_file(base, "bin", "rb");
+    FILE* index = open_log_file(base, "idx", "rb");
+    if (!data || !index) {
+        fprintf(stderr, "CANNOT OPEN EVENT LOG: %s\n", base);
+        if (data) fclose(data);
+        if (index) fclose(index);
+        return 1;
+    }
+    crc32_init();
+
+    double start = now_seconds();
+    long blocks = 0, bad_blocks = 0, index_matches = 0;
+    long long balls = 0, runs = 0, wickets = 0, index_balls = 0, bytes = 0;
+    int truncated = 0;
+    uint32_t capacity = 0;
+    BallRecord* records = NULL;
+    LogBlockHeader header;
+
+    while (fread(&header, sizeof(header), 1, data) == 1) {
+        if (header.magic != LOG_MAGIC || header.count > (1u << 24)) {
+            truncated = 1;
+            break;
+        }
+        if (header.count > capacity) {
+            BallRecord* grown = (BallRecord*)realloc(records, header.count * sizeof(BallRecord));
+            if (!grown) {
+                truncated = 1;
+                break;
+            }
+            records = grown;
+            capacity = header.count;
+        }
+        if (fread(records, sizeof(BallRecord), header.count, data) != header.count) {
+            truncated = 1;
+            break;
+        }
+
+        blocks++;
+        bytes += sizeof(header) + header.count * sizeof(BallRecord);
+        if (log_crc32(records, header.count * sizeof(BallRecord)) != header.crc) {
+            bad_blocks++;
+            continue;
+        }
+        for (uint32_t i = 0; i < header.count; i++) {
+            runs += records[i].runs;
+            wickets += records[i].wicket;
+        }
+        balls += header.count;
+    }
+
+    MatchIndexEntry entries[256];
+    size_t got;
+    while ((got = fread(entries, sizeof(MatchIndexEntry), 256, index)) > 0) {
+        for (size_t i = 0; i < got; i++) {
+            index_balls += entries[i].ball_count;
+        }
+        index_matches += (long)got;
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("BLOCKS: %ld (%ld BAD)  MATCHES: %ld  BALLS: %lld\n", blocks, bad_blocks, index_matches, balls);
+    printf("RUNS: %lld  WICKETS: %lld  RUNS/BALL: %.3f\n",
+           runs, wickets, balls > 0 ? (double)runs / balls : 0.0);
+    printf("READ %.1f MB IN %.3fs (%.0f MB/s, %.0f BALLS/SEC)\n",
+           bytes / 1e6, elapsed, elapsed > 0 ? bytes / 1e6 / elapsed : 0.0,
+           elapsed > 0 ? balls / elapsed : 0.0);
+    if (truncated) {
+        printf(RED "EVENT LOG ENDS IN A DAMAGED OR PARTIAL BLOCK\n" RESET);
+    }
+    if (bad_blocks == 0 && index_balls != balls) {
+        printf(RED "INDEX LISTS %lld BALLS BUT THE LOG HOLDS %lld\n" RESET, index_balls, balls);
+    }
+
+    free(records);
+    fclose(data);
+    fclose(index);
+    return bad_blocks > 0 || truncated ? 1 : 0;
+}
+
+static int load_rosters(const char* base, RosterRecord** rosters) {
+    FILE* fp = open_log_file(base, "rosters", "rb");
+    *rosters = NULL;
+    if (!fp) return -1;
+
+    fseek(fp, 0, SEEK_END);
+    long count = ftell(fp) / (long)sizeof(RosterRecord);
+    rewind(fp);
+
+    if (count > 0) {
+        *rosters = (RosterRecord*)malloc(count * sizeof(RosterRecord));
+        if (!*rosters || fread(*rosters, sizeof(RosterRecord), count, fp) != (size_t)count) {
+            free(*rosters);
+            *rosters = NULL;
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+    return (int)count;
+}
+
+/* Bytes of one column of a summary segment, in file order. */
+static size_t summary_column_size(int column, uint32_t count) {
+    static const size_t width[SUMMARY_COLUMNS] = {4, 4, 2, 2, 1, 1, 1, 1};
+    return width[column] * count;
+}
+
+static void** summary_slot(MatchSummary* s, int column) {
+    switch (column) {
+        case COL_ROSTER0: return (void**)&s->roster[0];
+        case COL_ROSTER1: return (void**)&s->roster[1];
+        case COL_RUNS0: return (void**)&s->runs[0];
+        case COL_RUNS1: return (void**)&s->runs[1];
+        case COL_WICKETS0: return (void**)&s->wickets[0];
+        case COL_WICKETS1: return (void**)&s->wickets[1];
+        case COL_WINNER: return (void**)&s->winner;
+        default: return (void**)&s->batting_first;
+    }
+}
+
+static long summary_count(const char* base) {
+    FILE* fp = open_log_file(base, "sum", "rb");
+    SummaryHeader header;
+    long count = 0;
+
+    if (!fp) return 0;
+    while (fread(&header, sizeof(header), 1, fp) == 1 && header.magic == SUMMARY_MAGIC) {
+        long size = 0;
+        for (int c = 0; c < SUMMARY_COLUMNS; c++) size += (long)summary_column_size(c, header.count);
+        if (fseek(fp, size, SEEK_CUR) != 0) break;
+        count += header.count;
+    }
+    fclose(fp);
+    return count;
+}
+
+void summary_free(MatchSummary* s) {
+    for (int c = 0; c < SUMMARY_COLUMNS; c++) {
+        free(*summary_slot(s, c));
+    }
+    memset(s, 0, sizeof(*s));
+}
+
+/* Streams BASE.sum one segment at a time through fixed buffers, reading
+   only the columns set in mask and seeking over the rest. Returns the
+   number of matches visited, or -1 if the summaries cannot be read. */
+long summary_scan(const char* base, unsigned mask, SummaryVisitor visit, void* ctx) {
+    FILE* fp = open_log_file(base, "sum", "rb");
+    SummaryHeader header;
+    MatchSummary s;
+    long visited = 0;
+
+    if (!fp) return -1;
+    memset(&s, 0, sizeof(s));
+    for (int c = 0; c < SUMMARY_COLUMNS; c++) {
+        if (!(mask & (1u << c))) continue;
+        *summary_slot(&s, c) = malloc(summary_column_size(c, SUMMARY_SEGMENT));
+        if (!*summary_slot(&s, c)) {
+            summary_free(&s);
+            fclose(fp);
+            return -1;
+        }
+    }
+
+    while (fread(&header, sizeof(header), 1, fp) == 1 &&
+           header.magic == SUMMARY_MAGIC && header.count <= SUMMARY_SEGMENT) {
+        int ok = 1;
+        for (int c = 0; ok && c < SUMMARY_COLUMNS; c++) {
+            size_t size = summary_column_size(c, header.count);
+            if (mask & (1u << c)) {
+                ok = fread(*summary_slot(&s, c), 1, size, fp) == size;
+            } else {
+                ok = fseek(fp, (long)size, SEEK_CUR) == 0;
+            }
+        }
+        if (!ok) break;
+        s.count = header.count;
+        visit(ctx, &s);
+        visited += header.count;
+    }
+
+    summary_free(&s);
+    fclose(fp);
+    return visited;
+}
+
+static int append_summary_segment(FILE* fp, const MatchIndexEntry* entries, uint32_t count) {
+    SummaryHeader header = {SUMMARY_MAGIC, count};
+    MatchSummary s;
+    int ok = 1;
+
+    memset(&s, 0, sizeof(s));
+    s.roster[0] = (uint32_t*)malloc(count * sizeof(uint32_t));
+    s.roster[1] = (uint32_t*)malloc(count * sizeof(uint32_t));
+    s.runs[0] = (uint16_t*)malloc(count * sizeof(uint16_t));
+    s.runs[1] = (uint16_t*)malloc(count * sizeof(uint16_t));
+    s.wickets[0] = (uint8_t*)malloc(count);
+    s.wickets[1] = (uint8_t*)malloc(count);
+    s.winner = (int8_t*)malloc(count);
+    s.batting_first = (uint8_t*)malloc(count);
+    for (int c = 0; c < SUMMARY_COLUMNS; c++) {
+        if (!*summary_slot(&s, c)) ok = 0;
+    }
+
+    if (ok) {
+        for (uint32_t i = 0; i < count; i++) {
+            for (int t = 0; t < MAX_TEAMS; t++) {
+                s.roster[t][i] = entries[i].roster[t];
+                s.runs[t][i] = entries[i].runs[t];
+                s.wickets[t][i] = entries[i].wickets[t];
+            }
+            s.winner[i] = entries[i].winner;
+            s.batting_first[i] = entries[i].batting_first;
+        }
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+        for (int c = 0; ok && c < SUMMARY_COLUMNS; c++) {
+            size_t size = summary_column_size(c, count);
+            ok = fwrite(*summary_slot(&s, c), 1, size, fp) == size;
+        }
+    }
+
+    summary_free(&s);
+    return ok;
+}
+
+static void add_match_players(PlayerAggregate* players, int roster_count, const MatchIndexEntry* e,
+                              const BallRecord* records) {
+    for (uint32_t i = 0; i < e->ball_count; i++) {
+        const BallRecord* r = &records[i];
+        int batting = r->innings == 1 ? e->batting_first : 1 - e->batting_first;
+        uint32_t bat_roster = e->roster[batting];
+        uint32_t bowl_roster = e->roster[1 - batting];
+
+        if (bat_roster < (uint32_t)roster_count && r->batsman < MAX_PLAYERS) {
+            PlayerAggregate* p = &players[bat_roster * MAX_PLAYERS + r->batsman];
+            p->runs += r->runs;
+            p->balls_faced++;
+            if (r->runs == 4) p->fours++;
+            if (r->runs == 6) p->sixes++;
+            if (r->wicket) p->outs++;
+        }
+        if (bowl_roster < (uint32_t)roster_count && r->bowler < MAX_PLAYERS) {
+            PlayerAggregate* p = &players[bowl_roster * MAX_PLAYERS + r->bowler];
+            p->balls_bowled++;
+            p->runs_conceded += r->runs;
+            if (r->wicket) p->wickets++;
+        }
+    }
+}
+
+static int write_aggregates(const char* base, const PlayerAggregate* players, int roster_count, uint64_t matches) {
+    char path[FILENAME_MAX], tmp[FILENAME_MAX];
+    AggregateHeader header = {AGGREGATE_MAGIC, (uint32_t)roster_count, matches};
+
+    snprintf(path, sizeof(path), "%s.agg", base);
+    snprintf(tmp, sizeof(tmp), "%s.agg.tmp", base);
+
+    FILE* fp = fopen(tmp, "wb");
+    if (!fp) return 0;
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(players, sizeof(PlayerAggregate), (size_t)roster_count * MAX_PLAYERS, fp) ==
+                 (size_t)roster_count * MAX_PLAYERS;
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok) {
+        remove(tmp);
+        return 0;
+    }
+#ifdef _WIN32
+    remove(path);
+#endif
+    return rename(tmp, path) == 0;
+}
+
+/* Loads BASE.agg into a zeroed array sized for roster_count squads.
+   Returns the number of matches it covers, or -1 if it is missing or
+   unreadable. */
+static long load_aggregates(const char* base, PlayerAggregate* players, int roster_count) {
+    FILE* fp = open_log_file(base, "agg", "rb");
+    AggregateHeader header;
+    long matches = -1;
+
+    if (!fp) return -1;
+    if (fread(&header, sizeof(header), 1, fp) == 1 && header.magic == AGGREGATE_MAGIC &&
+        header.roster_count <= (uint32_t)roster_count) {
+        size_t n = (size_t)header.roster_count * MAX_PLAYERS;
+        if (fread(players, sizeof(PlayerAggregate), n, fp) == n) matches = (long)header.matches;
+    }
+    fclose(fp);
+    return matches;
+}
+
+/* Appends summaries for the index entries after the first `done` and adds
+   their balls to the player totals. Returns the new number of summarised
+   matches, or -1 on a write error. */
+static long ingest_entries(FILE* index, FILE* data, FILE* sum, long done,
+                           PlayerAggregate* players, int roster_count, MatchIndexEntry* entries) {
+    BallRecord* block = NULL;
+    uint32_t block_capacity = 0;
+    uint64_t block_offset = UINT64_MAX;
+    int block_ok = 0;
+    size_t got;
+
+    fseek(index, done * (long)sizeof(MatchIndexEntry), SEEK_SET);
+    while ((got = fread(entries, sizeof(MatchIndexEntry), SUMMARY_SEGMENT, index)) > 0) {
+        if (!append_summary_segment(sum, entries, (uint32_t)got)) {
+            free(block);
+            return -1;
+        }
+
+        for (size_t i = 0; i < got; i++) {
+            const MatchIndexEntry* e = &entries[i];
+            if (e->block_offset != block_offset) {
+                LogBlockHeader header;
+                block_offset = e->block_offset;
+                block_ok = fseek(data, (long)block_offset, SEEK_SET) == 0 &&
+                           fread(&header, sizeof(header), 1, data) == 1 &&
+                           header.magic == LOG_MAGIC && header.count <= (1u << 24);
+                if (block_ok && header.count > block_capacity) {
+                    BallRecord* grown = (BallRecord*)realloc(block, header.count * sizeof(BallRecord));
+                    if (grown) {
+                        block = grown;
+                        block_capacity = header.count;
+                    } else {
+                        block_ok = 0;
+                    }
+                }
+                block_ok = block_ok &&
+                           fread(block, sizeof(BallRecord), header.count, data) == header.count &&
+                           log_crc32(block, header.count * sizeof(BallRecord)) == header.crc &&
+                           e->first_record + e->ball_count <= header.count;
+            } else if (block_ok && e->first_record + e->ball_count > block_capacity) {
+                block_ok = 0;
+            }
+            /* Balls in a damaged block are skipped; the match summary
+               still comes from the index. */
+            if (block_ok) {
+                add_match_players(players, roster_count, e, block + e->first_record);
+            }
+        }
+        done += (long)got;
+    }
+
+    free(block);
+    return done;
+}
+
+/* Brings BASE.sum and BASE.agg up to date with BASE.idx, reading only the
+   matches logged since the last run. Returns the number of matches in
+   the history, or -1 if it cannot be read. */
+long history_ingest(const char* base, long* added) {
+    RosterRecord* rosters;
+    int roster_count = load_rosters(base, &rosters);
+    free(rosters);
+    *added = 0;
+    if (roster_count < 0) return -1;
+
+    FILE* index = open_log_file(base, "idx", "rb");
+    FILE* data = open_log_file(base, "bin", "rb");
+    PlayerAggregate* players = (PlayerAggregate*)calloc((size_t)roster_count * MAX_PLAYERS + 1,
+                                                        sizeof(PlayerAggregate));
+    MatchIndexEntry* entries = (MatchIndexEntry*)malloc(SUMMARY_SEGMENT * sizeof(MatchIndexEntry));
+    FILE* sum = NULL;
+    long done = -1;
+
+    if (index && data && players && entries) {
+        crc32_init();
+        long summarised = summary_count(base);
+        if (load_aggregates(base, players, roster_count) != summarised) {
+            /* The two files disagree (or one is missing): start over. */
+            memset(players, 0, (size_t)roster_count * MAX_PLAYERS * sizeof(PlayerAggregate));
+            summarised = 0;
+            sum = open_log_file(base, "sum", "wb");
+        } else {
+            sum = open_log_file(base, "sum", "ab");
+        }
+        if (sum) {
+            done = ingest_entries(index, data, sum, summarised, players, roster_count, entries);
+            if (fclose(sum) != 0) done = -1;
+            if (done >= 0) {
+                *added = done - summarised;
+                if (*added > 0 && !write_aggregates(base, players, roster_count, (uint64_t)done)) done = -1;
+            }
+        }
+    }
+
+    if (index) fclose(index);
+    if (data) fclose(data);
+    free(players);
+    free(entries);
+    return done;
+}
+
+static double percentile(const uint32_t* histogram, int buckets, long total, double q) {
+    long want = (long)(q * (total - 1));
+    long seen = 0;
+    for (int i = 0; i < buckets; i++) {
+        seen += histogram[i];
+        if (seen > want) return i;
+    }
+    return buckets - 1;
+}
+
+/* Consecutive matches nearly always share both rosters, so results are
+   counted in locals over each run of one fixture. */
+static void wins_visit(void* ctx, const MatchSummary* s) {
+    WinsQuery* q = (WinsQuery*)ctx;
+
+    for (long i = 0; i < s->count; ) {
+        uint32_t r0 = s->roster[0][i], r1 = s->roster[1][i];
+        long start = i, wins0 = 0, ties = 0;
+        for (; i < s->count && s->roster[0][i] == r0 && s->roster[1][i] == r1; i++) {
+            wins0 += s->winner[i] == 0;
+            ties += s->winner[i] < 0;
+        }
+        long n = i - start;
+        if (r0 < (uint32_t)q->roster_count) {
+            q->played[r0] += n;
+            q->won[r0] += wins0;
+            q->tied[r0] += ties;
+        }
+        if (r1 < (uint32_t)q->roster_count) {
+            q->played[r1] += n;
+            q->won[r1] += n - wins0 - ties;
+            q->tied[r1] += ties;
+        }
+    }
+}
+
+static int query_wins(const char* base, const RosterRecord* rosters, int roster_count, const char* team) {
+    WinsQuery q;
+    q.roster_count = roster_count;
+    q.played = (long*)calloc(roster_count + 1, sizeof(long));
+    q.won = (long*)calloc(roster_count + 1, sizeof(long));
+    q.tied = (long*)calloc(roster_count + 1, sizeof(long));
+
+    int ok = q.played && q.won && q.tied &&
+             summary_scan(base, 1u << COL_ROSTER0 | 1u << COL_ROSTER1 | 1u << COL_WINNER, wins_visit, &q) >= 0;
+
+    /* A team keeps its record across squad changes, so rosters are
+       grouped by team name. */
+    if (ok) {
+        printf("%-20s %10s %10s %10s %10s %8s\n", "TEAM", "MATCHES", "WON", "LOST", "TIED", "WIN %");
+    }
+    for (int r = 0; ok && r < roster_count; r++) {
+        int first = 1;
+        for (int k = 0; k < r; k++) {
+            if (strcmp(rosters[k].team_name, rosters[r].team_name) == 0) first = 0;
+        }
+        if (!first || (team && strcmp(team, rosters[r].team_name) != 0)) continue;
+
+        long p = 0, w = 0, d = 0;
+        for (int k = r; k < roster_count; k++) {
+            if (strcmp(rosters[k].team_name, rosters[r].team_name) != 0) continue;
+            p += q.played[k];
+            w += q.won[k];
+            d += q.tied[k];
+        }
+        if (p == 0) continue;
+        printf("%-20s %10ld %10ld %10ld %10ld %7.2f%%\n",
+               rosters[r].team_name, p, w, p - w - d, d, 100.0 * w / p);
+    }
+
+    free(q.played);
+    free(q.won);
+    free(q.tied);
+    return ok;
+}
+
+static void scores_visit(void* ctx, const MatchSummary* s) {
+    ScoresQuery* q = (ScoresQuery*)ctx;
+    uint32_t* first = q->histogram[0];
+    uint32_t* chase = q->histogram[1];
+
+    if (q->wanted == NULL) {
+        for (long i = 0; i < s->count; i++) {
+            int swap = s->batting_first[i];
+            first[s->runs[swap][i]]++;
+            chase[s->runs[!swap][i]]++;
+        }
+        return;
+    }
+
+    for (long i = 0; i < s->count; i++) {
+        for (int t = 0; t < MAX_TEAMS; t++) {
+            uint32_t r = s->roster[t][i];
+            if (r >= (uint32_t)q->roster_count || !q->wanted[r]) continue;
+            q->histogram[s->batting_first[i] != t][s->runs[t][i]]++;
+        }
+    }
+}
+
+static int query_scores(const char* base, const RosterRecord* rosters, int roster_count, const char* team) {
+    ScoresQuery q;
+    uint8_t* wanted = NULL;
+    unsigned mask = 1u << COL_RUNS0 | 1u << COL_RUNS1 | 1u << COL_BATTING_FIRST;
+    long total[2] = {0, 0};
+    double sum[2] = {0.0, 0.0};
+    int top = 0;
+
+    q.roster_count = roster_count;
+    q.histogram[0] = (uint32_t*)calloc(65536, sizeof(uint32_t));
+    q.histogram[1] = (uint32_t*)calloc(65536, sizeof(uint32_t));
+    if (team) {
+        wanted = (uint8_t*)calloc(roster_count + 1, 1);
+        for (int r = 0; wanted && r < roster_count; r++) {
+            wanted[r] = strcmp(rosters[r].team_name, team) == 0;
+        }
+        mask |= 1u << COL_ROSTER0 | 1u << COL_ROSTER1;
+    }
+    q.wanted = wanted;
+
+    int ok = q.histogram[0] && q.histogram[1] && (!team || wanted) &&
+             summary_scan(base, mask, scores_visit, &q) >= 0;
+    if (!ok) {
+        free(q.histogram[0]);
+        free(q.histogram[1]);
+        free(wanted);
+        return 0;
+    }
+
+    uint32_t** histogram = q.histogram;
+    for (int k = 0; k < 2; k++) {
+        for (int r = 0; r < 65536; r++) {
+            if (histogram[k][r] == 0) continue;
+            total[k] += histogram[k][r];
+            sum[k] += (double)r * histogram[k][r];
+            top = r > top ? r : top;
+        }
+    }
+
+    const char* label[2] = {"BATTING FIRST", "CHASING"};
+    printf("%-14s %10s %8s %6s %6s %6s %6s\n", "INNINGS", "INNINGS", "MEAN", "P10", "P50", "P90", "MAX");
+    for (int k = 0; k < 2; k++) {
+        if (total[k] == 0) continue;
+        int max = 0;
+        for (int r = 0; r <= top; r++) {
+            if (histogram[k][r]) max = r;
+        }
+        printf("%-14s %10ld %8.2f %6.0f %6.0f %6.0f %6d\n", label[k], total[k], sum[k] / total[k],
+               percentile(histogram[k], top + 1, total[k], 0.1),
+               percentile(histogram[k], top + 1, total[k], 0.5),
+               percentile(histogram[k], top + 1, total[k], 0.9), max);
+    }
+
+    int width = top / 20 + 1;
+    width = width < 5 ? 5 : (width + 4) / 5 * 5;
+    printf("\n%-11s %14s %14s\n", "RUNS", label[0], label[1]);
+    for (int lo = 0; lo <= top; lo += width) {
+        double share[2] = {0.0, 0.0};
+        for (int k = 0; k < 2; k++) {
+            long n = 0;
+            for (int r = lo; r < lo + width && r <= top; r++) n += histogram[k][r];
+            share[k] = total[k] ? 100.0 * n / total[k] : 0.0;
+        }
+        char range[24];
+        snprintf(range, sizeof(range), "%d-%d", lo, lo + width - 1);
+        printf("%-11s %13.2f%% %13.2f%%  ", range, share[0], share[1]);
+        for (int b = 0; b < (int)(share[0] / 2); b++) putchar('#');
+        putchar('\n');
+    }
+
+    free(q.histogram[0]);
+    free(q.histogram[1]);
+    free(wanted);
+    return 1;
+}
+
+static int compare_runs(const void* a, const void* b) {
+    const PlayerTotal* x = (const PlayerTotal*)a;
+    const PlayerTotal* y = (const PlayerTotal*)b;
+    if (x->stats.runs != y->stats.runs) return x->stats.runs < y->stats.runs ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+static int compare_wickets(const void* a, const void* b) {
+    const PlayerTotal* x = (const PlayerTotal*)a;
+    const PlayerTotal* y = (const PlayerTotal*)b;
+    if (x->stats.wickets != y->stats.wickets) return x->stats.wickets < y->stats.wickets ? 1 : -1;
+    if (x->stats.runs_conceded != y->stats.runs_conceded) return x->stats.runs_conceded > y->stats.runs_conceded ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+static int query_players(const char* base, const RosterRecord* rosters, int roster_count,
+                         const char* team, int top, int by_wickets) {
+    PlayerAggregate* players = (PlayerAggregate*)calloc((size_t)roster_count * MAX_PLAYERS + 1,
+                                                        sizeof(PlayerAggregate));
+    PlayerTotal* totals = (PlayerTotal*)calloc((size_t)roster_count * MAX_PLAYERS + 1, sizeof(PlayerTotal));
+    int count = 0;
+
+    if (!players || !totals || load_aggregates(base, players, roster_count) < 0) {
+        free(players);
+        free(totals);
+        return 0;
+    }
+
+    /* The same player in several versions of a squad is one entry. */
+    for (int r = 0; r < roster_count; r++) {
+        if (team && strcmp(team, rosters[r].team_name) != 0) continue;
+        for (int i = 0; i < rosters[r].player_count && i < MAX_PLAYERS; i++) {
+            const PlayerAggregate* p = &players[r * MAX_PLAYERS + i];
+            int k;
+            for (k = 0; k < count; k++) {
+                if (strcmp(totals[k].name, rosters[r].players[i]) == 0 &&
+                    strcmp(totals[k].team, rosters[r].team_name) == 0) break;
+            }
+            if (k == count) {
+                totals[k].name = rosters[r].players[i];
+                totals[k].team = rosters[r].team_name;
+                count++;
+            }
+            totals[k].stats.runs += p->runs;
+            totals[k].stats.balls_faced += p->balls_faced;
+            totals[k].stats.fours += p->fours;
+            totals[k].stats.sixes += p->sixes;
+            totals[k].stats.outs += p->outs;
+            totals[k].stats.balls_bowled += p->balls_bowled;
+            totals[k].stats.runs_conceded += p->runs_conceded;
+            totals[k].stats.wickets += p->wickets;
+        }
+    }
+
+    qsort(totals, count, sizeof(PlayerTotal), by_wickets ? compare_wickets : compare_runs);
+    if (top > count) top = count;
+
+    if (by_wickets) {
+        printf("%-20s %-20s %10s %12s %10s %8s\n", "PLAYER", "TEAM", "WICKETS", "RUNS", "BALLS", "ECON");
+        for (int k = 0; k < top; k++) {
+            const PlayerAggregate* p = &totals[k].stats;
+            printf("%-20s %-20s %10llu %12llu %10llu %8.2f\n", totals[k].name, totals[k].team,
+                   (unsigned long long)p->wickets, (unsigned long long)p->runs_conceded,
+                   (unsigned long long)p->balls_bowled,
+                   p->balls_bowled ? 6.0 * p->runs_conceded / p->balls_bowled : 0.0);
+        }
+    } else {
+        printf("%-20s %-20s %12s %10s %8s %8s\n", "PLAYER", "TEAM", "RUNS", "BALLS", "SR", "AVG");
+        for (int k = 0; k < top; k++) {
+            const PlayerAggregate* p = &totals[k].stats;
+            printf("%-20s %-20s %12llu %10llu %8.2f %8.2f\n", totals[k].name, totals[k].team,
+                   (unsigned long long)p->runs, (unsigned long long)p->balls_faced,
+                   p->balls_faced ? 100.0 * p->runs / p->balls_faced : 0.0,
+                   p->outs ? (double)p->runs / p->outs : (double)p->runs);
+        }
+    }
+
+    free(players);
+    free(totals);
+    return 1;
+}
+
+int run_history_query(const char* base, const char* query, const char* team, int top) {
+    if (strcmp(query, "wins") != 0 && strcmp(query, "scores") != 0 &&
+        strcmp(query, "top-scorers") != 0 && strcmp(query, "top-wickets") != 0) {
+        fprintf(stderr, "UNKNOWN QUERY: %s (USE wins, scores, top-scorers OR top-wickets)\n", query);
+        return 1;
+    }
+
+    double start = now_seconds();
+    long added;
+    long matches = history_ingest(base, &added);
+    double ingested = now_seconds();
+
+    RosterRecord* rosters = NULL;
+    int roster_count = matches < 0 ? -1 : load_rosters(base, &rosters);
+    int ok = roster_count >= 0;
+
+    if (ok && strcmp(query, "wins") == 0) {
+        ok = query_wins(base, rosters, roster_count, team);
+    } else if (ok && strcmp(query, "scores") == 0) {
+        ok = query_scores(base, rosters, roster_count, team);
+    } else if (ok) {
+        ok = query_players(base, rosters, roster_count, team, top, strcmp(query, "top-wickets") == 0);
+    }
+    free(rosters);
+
+    if (!ok) {
+        fprintf(stderr, "CANNOT READ MATCH HISTORY: %s\n", base);
+        return 1;
+    }
+    printf("\n%ld MATCHES (%ld NEWLY INDEXED IN %.1f ms), QUERY %.1f ms\n",
+           matches, added, (ingested - start) * 1e3, (now_seconds() - ingested) * 1e3);
+    return 0;
+}
+
+/* Takes ownership of balls and plays them once from start, keeping a
+   keyframe every REPLAY_KEYFRAME balls. Returns how many balls fit the
+   match; fewer than count means the record is inconsistent, and -1 that
+   there was no memory for the keyframes. */
+int replay_build(Replay* r, const MatchState* start, BallRecord* balls, int count) {
+    BallResult result;
+    
+    r->balls = balls;
+    r->ball_count = count;
+    r->batting_first = start->currently_batting;
+    r->keyframe_count = count / REPLAY_KEYFRAME + 1;
+    r->keyframes = (MatchState*)malloc(r->keyframe_count * sizeof(MatchState));
+    if (!r->keyframes) return -1;
+    
+    r->state = *start;
+    r->position = 0;
+    for (int i = 0; i < count; i++) {
+        if (i % REPLAY_KEYFRAME == 0) r->keyframes[i / REPLAY_KEYFRAME] = r->state;
+        if (!replay_ball(&r->state, &balls[i], &result)) return i;
+        r->position++;
+    }
+    if (count % REPLAY_KEYFRAME == 0) r->keyframes[count / REPLAY_KEYFRAME] = r->state;
+    return count;
+}
+
+/* Moves to the state after `position` balls. Going back, or a long way
+   forward, restarts from the keyframe at or before the position, so no
+   seek replays more than REPLAY_KEYFRAME - 1 balls. */
+void replay_seek(Replay* r, int position) {
+    BallResult result;
+    
+    if (position < 0) position = 0;
+    if (position > r->ball_count) position = r->ball_count;
+    if (position < r->position || position - r->position >= REPLAY_KEYFRAME) {
+        r->state = r->keyframes[position / REPLAY_KEYFRAME];
+        r->position = position / REPLAY_KEYFRAME * REPLAY_KEYFRAME;
+    }
+    while (r->position < position) {
+        replay_ball(&r->state, &r->balls[r->position++], &result);
+    }
+}
+
+void replay_free(Replay* r) {
+    free(r->balls);
+    free(r->keyframes);
+    r->balls = NULL;
+    r->keyframes = NULL;
+}
+
+/* Finds match_id in BASE.idx. Ids are handed out in index order, so the
+   entry is normally at position match_id; a parallel batch can write its
+   blocks out of order, which the scan covers. */
+static int find_index_entry(const char* base, uint32_t match_id, MatchIndexEntry* entry) {
+    FILE* fp = open_log_file(base, "idx", "rb");
+    int found = 0;
+    
+    if (!fp) return 0;
+    if (fseek(fp, (long)match_id * (long)sizeof(MatchIndexEntry), SEEK_SET) == 0 &&
+        fread(entry, sizeof(*entry), 1, fp) == 1 && entry->match_id == match_id) {
+        found = 1;
+    }
+    rewind(fp);
+    while (!found && fread(entry, sizeof(*entry), 1, fp) == 1) {
+        found = entry->match_id == match_id;
+    }
+    fclose(fp);
+    return found;
+}
+
+/* Ratings are not logged, so every player gets the default. */
+static void roster_team(const RosterRecord* r, Team* team) {
+    memset(team, 0, sizeof(*team));
+    memcpy(team->name, r->team_name, MAX_NAME_LENGTH);
+    team->name[MAX_NAME_LENGTH - 1] = '\0';
+    team->player_count = r->player_count < MAX_PLAYERS ? r->player_count : MAX_PLAYERS;
+    for (int i = 0; i < team->player_count; i++) {
+        memcpy(team->player_names[i], r->players[i], MAX_NAME_LENGTH);
+        team->player_names[i][MAX_NAME_LENGTH - 1] = '\0';
+        team->players[i].is_bowler = r->is_bowler[i];
+        team->players[i].batting = RATING_DEFAULT;
+        team->players[i].bowling = RATING_DEFAULT;
+    }
+}
+
+/* Reads the balls of one match out of its checksummed block. */
+static BallRecord* read_match_balls(const char* base, const MatchIndexEntry* entry) {
+    FILE* data = open_log_file(base, "bin", "rb");
+    LogBlockHeader header;
+    BallRecord* block = NULL;
+    BallRecord* balls = NULL;
+    
+    if (!data) return NULL;
+    crc32_init();
+    if (fseek(data, (long)entry->block_offset, SEEK_SET) == 0 &&
+        fread(&header, sizeof(header), 1, data) == 1 &&
+        header.magic == LOG_MAGIC && header.count <= (1u << 24) &&
+        entry->ball_count > 0 && entry->first_record + entry->ball_count <= header.count) {
+        block = (BallRecord*)malloc(header.count * sizeof(BallRecord));
+    }
+    if (block && fread(block, sizeof(BallRecord), header.count, data) == header.count &&
+        log_crc32(block, header.count * sizeof(BallRecord)) == header.crc) {
+        balls = (BallRecord*)malloc(entry->ball_count * sizeof(BallRecord));
+        if (balls) memcpy(balls, block + entry->first_record, entry->ball_count * sizeof(BallRecord));
+    }
+    free(block);
+    fclose(data);
+    return balls;
+}
+
+/* Rebuilds a logged match from its rosters and ball records. */
+static int replay_open_log(Replay* r, const char* base, uint32_t match_id) {
+    MatchIndexEntry entry;
+    RosterRecord* rosters = NULL;
+    Team squads[MAX_TEAMS];
+    MatchState* start;
+    
+    if (!find_index_entry(base, match_id, &entry)) {
+        fprintf(stderr, "MATCH %u IS NOT IN THE EVENT LOG: %s\n", match_id, base);
+        return 0;
+    }
+    int roster_count = load_rosters(base, &rosters);
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        if (entry.roster[t] >= (uint32_t)(roster_count > 0 ? roster_count : 0)) {
+            fprintf(stderr, "CANNOT READ THE SQUADS OF MATCH %u: %s\n", match_id, base);
+            free(rosters);
+            return 0;
+        }
+        roster_team(&rosters[entry.roster[t]], &squads[t]);
+    }
+    free(rosters);
+    
+    BallRecord* balls = read_match_balls(base, &entry);
+    if (!balls) {
+        fprintf(stderr, "CANNOT READ THE BALLS OF MATCH %u: %s\n", match_id, base);
+        return 0;
+    }
+    
+    GameConfig cfg = config;
+    cfg.max_overs = entry.max_overs;
+    start = (MatchState*)malloc(sizeof(MatchState));
+    if (!start) {
+        free(balls);
+        return 0;
+    }
+    match_init(start, squads, &cfg);
+    start->currently_batting = entry.batting_first & 1;
+    
+    int count = (int)entry.ball_count;
+    int fitted = replay_build(r, start, balls, count);
+    free(start);
+    if (fitted != count || !r->state.match_over ||
+        r->state.teams[0].total_runs != entry.runs[0] || r->state.teams[1].total_runs != entry.runs[1] ||
+        r->state.teams[0].total_wickets != entry.wickets[0] ||
+        r->state.teams[1].total_wickets != entry.wickets[1]) {
+        fprintf(stderr, "THE RECORD OF MATCH %u DOES NOT ADD UP (BALL %d OF %d)\n",
+                match_id, fitted + 1, count);
+        replay_free(r);
+        return 0;
+    }
+    return 1;
+}
+
+/* Plays match_number of a batch again: same seed, same stream, same toss
+   as run_batch, so the balls come out exactly as they did in a batch run
+   on the scalar kernel. */
+static int replay_open_seed(Replay* r, const MatchState* base, long match_number, uint64_t seed) {
+    BallResult result;
+    MatchState* m = (MatchState*)malloc(2 * sizeof(MatchState));
+    int capacity = base->config.max_overs * 12;
+    BallRecord* balls = (BallRecord*)malloc(capacity * sizeof(BallRecord));
+    int count = 0;
+    
+    if (!m || !balls) {
+        free(m);
+        free(balls);
+        return 0;
+    }
+    m[0] = *base;
+    reset_match_state(&m[0]);
+    rng_stream(&m[0].rng, seed, (uint64_t)match_number);
+    m[0].currently_batting = (int)(rng_next(&m[0].rng) >> 63);
+    m[1] = m[0];
+    
+    while (!m[1].match_over && count < capacity) {
+        int batting = m[1].currently_batting;
+        int innings = m[1].first_innings ? 1 : 2;
+        if (play_ball(&m[1], &result) <= 0) break;
+        fill_ball_record(&balls[count++], (uint32_t)match_number, innings,
+                         m[1].teams[batting].total_balls, &result);
+    }
+    
+    int fitted = replay_build(r, &m[0], balls, count);
+    free(m);
+    if (fitted != count) {
+        replay_free(r);
+        return 0;
+    }
+    return 1;
+}
+
+/* The scoreboard after the current ball, then a line on that ball. */
+static void replay_show(const Replay* r, const char* title, int clear) {
+    display_scoreboard(&r->state, clear);
+    printf(CYAN "%s\n" RESET, title);
+    if (r->position == 0) {
+        printf("BALL 0 OF %d: BEFORE THE FIRST BALL\n", r->ball_count);
+        return;
+    }
+    
+    const BallRecord* b = &r->balls[r->position - 1];
+    int batting = b->innings == 1 ? r->batting_first : 1 - r->batting_first;
+    const Team* bat = &r->state.teams[batting];
+    const Team* bowl = &r->state.teams[1 - batting];
+    printf("BALL %d OF %d: INNINGS %d, OVER %d.%d, %s TO %s, %d RUN%s",
+           r->position, r->ball_count, b->innings, (b->ball - 1) / 6, (b->ball - 1) % 6 + 1,
+           bowl->player_names[b->bowler], bat->player_names[b->batsman],
+           b->runs, b->runs == 1 ? "" : "S");
+    if (b->wicket) printf(RED " - WICKET!" RESET);
+    printf("\n");
+}
+
+/* Replays a match from the event log at base, or, when seeded is given,
+   match_number of a batch played with seed on that configuration. With
+   at_ball >= 0 the board after that ball is printed; otherwise the viewer
+   steps through the match until q or end of input. */
+int run_replay(const char* base, uint32_t match_id, const MatchState* seeded, long match_number,
+               uint64_t seed, int at_ball) {
+    Replay r;
+    char title[256];
+    char line[64];
+    
+    memset(&r, 0, sizeof(r));
+    if (seeded) {
+        if (!replay_open_seed(&r, seeded, match_number, seed)) {
+            fprintf(stderr, "CANNOT REPLAY MATCH %ld\n", match_number);
+            return 1;
+        }
+        snprintf(title, sizeof(title), "BATCH MATCH %ld (SEED %llu): %s VS %s",
+                 match_number, (unsigned long long)seed, r.state.teams[0].name, r.state.teams[1].name);
+    } else {
+        if (!replay_open_log(&r, base, match_id)) return 1;
+        snprintf(title, sizeof(title), "MATCH %u FROM %s: %s VS %s",
+                 match_id, base, r.state.teams[0].name, r.state.teams[1].name);
+    }
+    
+    if (at_ball >= 0) {
+        replay_seek(&r, at_ball);
+        replay_show(&r, title, 0);
+        replay_free(&r);
+        return 0;
+    }
+    
+    replay_seek(&r, 0);
+    for (;;) {
+        replay_show(&r, title, 1);
+        printf(WHITE "\nn NEXT, p PREVIOUS (EITHER WITH A COUNT), g N GO TO BALL N, q QUIT: " RESET);
+        fflush(stdout);
+        if (!fgets(line, sizeof(line), stdin)) break;
+        
+        long count = strtol(line + 1, NULL, 10);
+        long step = count > 0 ? count : 1;
+        if (line[0] == 'q' || line[0] == 'Q') {
+            break;
+        } else if (line[0] == 'p' || line[0] == 'P') {
+            replay_seek(&r, r.position - (int)(step < r.position ? step : r.position));
+        } else if (line[0] == 'g' || line[0] == 'G') {
+            replay_seek(&r, (int)(count < r.ball_count ? count : r.ball_count));
+        } else {
+            replay_seek(&r, r.position + (int)(step < r.ball_count ? step : r.ball_count));
+        }
+    }
+    printf("\n");
+    replay_free(&r);
+    return 0;
+}
+
+static size_t save_align(size_t n) {
+    return (n + SAVE_ALIGN - 1) & ~(size_t)(SAVE_ALIGN - 1);
+}
+
+static const uint32_t save_record_size[SAVE_SECTIONS] = {
+    sizeof(SavedTeam), sizeof(SavedMatch), sizeof(BallRecord)
+};
+
+/* Creates a zeroed save file at path with room for counts[k] records of
+   each section, and maps it. The caller fills the records in place and
+   seals the file with save_commit(). */
+int save_create(SaveImage* img, const char* path, const uint32_t counts[SAVE_SECTIONS]) {
+    SaveSection table[SAVE_SECTIONS];
+    size_t offset = save_align(sizeof(SaveHeader) + sizeof(table));
+    
+    for (int k = 0; k < SAVE_SECTIONS; k++) {
+        table[k].kind = (uint32_t)k;
+        table[k].record_size = save_record_size[k];
+        table[k].count = counts[k];
+        table[k].reserved = 0;
+        table[k].offset = offset;
+        offset = save_align(offset + (size_t)counts[k] * save_record_size[k]);
+    }
+    
+    remove(path);
+    if (!map_file(&img->file, path, offset)) return 0;
+    img->header = (SaveHeader*)img->file.data;
+    img->sections = (SaveSection*)((char*)img->file.data + sizeof(SaveHeader));
+    img->header->magic = SAVE_MAGIC;
+    img->header->version = SAVE_VERSION;
+    img->header->byte_order = SAVE_BYTE_ORDER;
+    img->header->section_count = SAVE_SECTIONS;
+    img->header->size = offset;
+    memcpy(img->sections, table, sizeof(table));
+    return 1;
+}
+
+/* Checksums everything after the header, unmaps the file and renames it
+   over path, so a reader sees the old save or the new one, never half. */
+int save_commit(SaveImage* img, const char* tmp_path, const char* path) {
+    crc32_init();
+    img->header->crc = log_crc32((char*)img->file.data + sizeof(SaveHeader),
+                                 img->file.size - sizeof(SaveHeader));
+    unmap_file(&img->file);
+#ifdef _WIN32
+    remove(path);
+#endif
+    return rename(tmp_path, path) == 0;
+}
+
+/* Maps a save file and checks its header, section table and checksum.
+   Nothing is converted: the sections are read where they lie. Returns -1
+   if there is no such file and 0 if it is not a usable save. */
+int save_open(SaveImage* img, const char* path) {
+    FILE* probe = fopen(path, "rb");
+    
+    if (!probe) return -1;
+    fclose(probe);
+    if (!map_file(&img->file, path, 0)) return 0;
+    
+    img->header = (SaveHeader*)img->file.data;
+    img->sections = (SaveSection*)((char*)img->file.data + sizeof(SaveHeader));
+    size_t size = img->file.size;
+    int ok = size >= sizeof(SaveHeader) &&
+             img->header->magic == SAVE_MAGIC &&
+             img->header->version == SAVE_VERSION &&
+             img->header->byte_order == SAVE_BYTE_ORDER &&
+             img->header->size == size &&
+             img->header->section_count <= 64 &&
+             sizeof(SaveHeader) + img->header->section_count * sizeof(SaveSection) <= size;
+    
+    for (uint32_t i = 0; ok && i < img->header->section_count; i++) {
+        const SaveSection* section = &img->sections[i];
+        ok = section->offset % SAVE_ALIGN == 0 &&
+             section->offset + (uint64_t)section->count * section->record_size <= size &&
+             (section->kind >= SAVE_SECTIONS || section->record_size == save_record_size[section->kind]);
+    }
+    if (ok) {
+        crc32_init();
+        ok = log_crc32((char*)img->file.data + sizeof(SaveHeader), size - sizeof(SaveHeader)) ==
+             img->header->crc;
+    }
+    if (!ok) unmap_file(&img->file);
+    return ok;
+}
+
+void save_close(SaveImage* img) {
+    unmap_file(&img->file);
+}
+
+/* The records of one section, or NULL with *count 0 if it is absent.
+   Sections of kinds this version does not know are skipped. */
+void* save_section(const SaveImage* img, int kind, uint32_t* count) {
+    for (uint32_t i = 0; i < img->header->section_count; i++) {
+        if (img->sections[i].kind == (uint32_t)kind) {
+            *count = img->sections[i].count;
+            return (char*)img->file.data + img->sections[i].offset;
+        }
+    }
+    *count = 0;
+    return NULL;
+}
+
+void team_to_saved(const Team* t, SavedTeam* s) {
+    memset(s, 0, sizeof(*s));
+    memcpy(s->name, t->name, MAX_NAME_LENGTH);
+    s->player_count = t->player_count;
+    s->total_runs = t->total_runs;
+    s->total_wickets = t->total_wickets;
+    s->total_balls = t->total_balls;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        const Player* p = &t->players[i];
+        SavedPlayer* q = &s->players[i];
+        memcpy(q->name, t->player_names[i], MAX_NAME_LENGTH);
+        q->is_bowler = (uint8_t)(p->is_bowler != 0);
+        q->is_out = (uint8_t)(p->is_out != 0);
+        q->batting = p->batting;
+        q->bowling = p->bowling;
+        q->runs = p->runs;
+        q->balls_faced = p->balls_faced;
+        q->fours = p->fours;
+        q->sixes = p->sixes;
+        q->balls_bowled = p->balls_bowled;
+        q->runs_conceded = p->runs_conceded;
+        q->wickets = p->wickets;
+    }
+}
+
+void team_from_saved(const SavedTeam* s, Team* t) {
+    memset(t, 0, sizeof(*t));
+    memcpy(t->name, s->name, MAX_NAME_LENGTH);
+    t->name[MAX_NAME_LENGTH - 1] = '\0';
+    t->player_count = s->player_count < 0 ? 0 : s->player_count > MAX_PLAYERS ? MAX_PLAYERS : s->player_count;
+    t->total_runs = s->total_runs;
+    t->total_wickets = s->total_wickets;
+    t->total_balls = s->total_balls;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        const SavedPlayer* q = &s->players[i];
+        Player* p = &t->players[i];
+        memcpy(t->player_names[i], q->name, MAX_NAME_LENGTH);
+        t->player_names[i][MAX_NAME_LENGTH - 1] = '\0';
+        p->is_bowler = q->is_bowler;
+        p->is_out = q->is_out;
+        p->batting = (uint8_t)player_rating(q->batting);
+        p->bowling = (uint8_t)player_rating(q->bowling);
+        p->runs = q->runs;
+        p->balls_faced = q->balls_faced;
+        p->fours = q->fours;
+        p->sixes = q->sixes;
+        p->balls_bowled = q->balls_bowled;
+        p->runs_conceded = q->runs_conceded;
+        p->wickets = (uint8_t)q->wickets;
+    }
+}
+
+void match_to_saved(const MatchState* m, SavedMatch* s) {
+    memset(s, 0, sizeof(*s));
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        team_to_saved(&m->teams[t], &s->teams[t]);
+    }
+    s->max_overs = m->config.max_overs;
+    s->wicket_probability = m->config.wicket_probability;
+    memcpy(s->run_weights, m->config.run_weights, sizeof(s->run_weights));
+    memcpy(s->tournament_name, m->config.tournament_name, sizeof(s->tournament_name));
+    s->currently_batting = m->currently_batting;
+    s->first_innings = m->first_innings;
+    s->match_over = m->match_over;
+    s->current_batsman = m->current_batsman;
+    s->current_bowler_idx = m->current_bowler_idx;
+    memcpy(s->rng, m->rng.s, sizeof(s->rng));
+}
+
+/* The outcome model and matchup table are rebuilt rather than stored. */
+void match_from_saved(const SavedMatch* s, MatchState* m) {
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        team_from_saved(&s->teams[t], &m->teams[t]);
+    }
+    m->config.max_overs = s->max_overs > 0 ? s->max_overs : DEFAULT_OVERS;
+    m->config.wicket_probability = s->wicket_probability;
+    memcpy(m->config.run_weights, s->run_weights, sizeof(m->config.run_weights));
+    memcpy(m->config.tournament_name, s->tournament_name, sizeof(m->config.tournament_name));
+    m->config.tournament_name[sizeof(m->config.tournament_name) - 1] = '\0';
+    m->currently_batting = s->currently_batting & 1;
+    m->first_innings = s->first_innings != 0;
+    m->match_over = s->match_over != 0;
+    m->current_batsman = s->current_batsman >= 0 && s->current_batsman < MAX_PLAYERS ? s->current_batsman : 0;
+    m->current_bowler_idx = s->current_bowler_idx >= 0 && s->current_bowler_idx < MAX_PLAYERS
+                            ? s->current_bowler_idx : 0;
+    memcpy(m->rng.s, s->rng, sizeof(m->rng.s));
+    m->wicket_threshold = (uint64_t)(m->config.wicket_probability * 4294967296.0);
+    m->model = outcome_model_for(&m->config);
+    match_prepare(m);
+}
+
+/* Writes both squads and, if the user left a match part-way, that match
+   with the balls of it already in the history buffer. */
+int save_game_file(void) {
+    SaveImage img;
+    uint32_t counts[SAVE_SECTIONS] = {MAX_TEAMS, 0, 0};
+    uint32_t n;
+    
+    if (match_paused) {
+        counts[SAVE_MATCHES] = 1;
+        if (history_open) counts[SAVE_BALLS] = match_events.count - match_events.first_record;
+    }
+    if (!save_create(&img, SAVE_FILE_TMP, counts)) return 0;
+    
+    SavedTeam* saved_teams = (SavedTeam*)save_section(&img, SAVE_TEAMS, &n);
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        team_to_saved(&teams[t], &saved_teams[t]);
+    }
+    if (match_paused) {
+        SavedMatch* saved = (SavedMatch*)save_section(&img, SAVE_MATCHES, &n);
+        BallRecord* balls = (BallRecord*)save_section(&img, SAVE_BALLS, &n);
+        match_to_saved(&match, saved);
+        saved->ball_count = counts[SAVE_BALLS];
+        if (n > 0) memcpy(balls, match_events.records + match_events.first_record, n * sizeof(BallRecord));
+    }
+    return save_commit(&img, SAVE_FILE_TMP, SAVE_FILE);
+}
+
+/* Restores the squads and any paused match. A paused match's logged balls
+   go back into the history buffer, so the whole match is logged when it
+   ends. Returns -1 if there is no save, 0 if it is unusable, else 1. */
+int load_game_file(void) {
+    SaveImage img;
+    uint32_t n, ball_total;
+    int status = save_open(&img, SAVE_FILE);
+    
+    if (status <= 0) return status;
+    
+    const SavedTeam* saved_teams = (const SavedTeam*)save_section(&img, SAVE_TEAMS, &n);
+    for (uint32_t t = 0; t < n && t < MAX_TEAMS; t++) {
+        team_from_saved(&saved_teams[t], &teams[t]);
+    }
+    
+    const SavedMatch* saved = (const SavedMatch*)save_section(&img, SAVE_MATCHES, &n);
+    const BallRecord* balls = (const BallRecord*)save_section(&img, SAVE_BALLS, &ball_total);
+    if (n > 0 && !saved[0].match_over) {
+        match_from_saved(&saved[0], &match);
+        match_paused = 1;
+        
+        uint32_t count = saved[0].ball_count;
+        if (history_open && saved[0].first_ball + (uint64_t)count <= ball_total &&
+            count <= match_events.capacity) {
+            match_events.count = 0;
+            match_events.match_count = 0;
+            for (int t = 0; t < MAX_TEAMS; t++) {
+                match_events.roster[t] = event_log_roster(&history, &match.teams[t]);
+            }
+            log_begin_match(&match_events, history.next_match, &match);
+            match_events.batting_first = match.first_innings ? match.currently_batting
+                                                             : 1 - match.currently_batting;
+            memcpy(match_events.records, balls + saved[0].first_ball, count * sizeof(BallRecord));
+            for (uint32_t i = 0; i < count; i++) {
+                match_events.records[i].match_id = history.next_match;
+            }
+            match_events.count = count;
+        }
+    }
+    save_close(&img);
+    return 1;
+}
+
+/* Copies a team or player name into a MAX_NAME_LENGTH buffer, cutting it
+   short if needed. Returns 0 if the name did not fit. */
+int copy_name(char* dst, const char* src) {
+    snprintf(dst, MAX_NAME_LENGTH, "%.*s", MAX_NAME_LENGTH - 1, src);
+    return strlen(src) < MAX_NAME_LENGTH;
+}
+
+void default_roster(Team* team, const char* name) {
+    memset(team, 0, sizeof(*team));
+    copy_name(team->name, name);
+    
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        snprintf(team->player_names[i], MAX_NAME_LENGTH, "PLAYER %d", i + 1);
+        team->players[i].is_bowler = i >= MAX_PLAYERS - 5;
+        team->players[i].batting = RATING_DEFAULT;
+        team->players[i].bowling = RATING_DEFAULT;
+    }
+    team->player_count = MAX_PLAYERS;
+}
+
+/* Reads one roster line, already trimmed to [start, end): a name with an
+   optional trailing '*' for a bowler and optional bat=N / bowl=N ratings. */
+static void parse_player(char* start, char* end, Player* p, PlayerName name) {
+    memset(p, 0, sizeof(*p));
+    memset(name, 0, MAX_NAME_LENGTH);
+    p->batting = RATING_DEFAULT;
+    p->bowling = RATING_DEFAULT;
+    for (;;) {
+        char* field = end;
+        while (field > start && field[-1] != ' ' && field[-1] != '\t') field--;
+        if (strncmp(field, "bat=", 4) == 0) {
+            p->batting = (uint8_t)player_rating(atoi(field + 4));
+        } else if (strncmp(field, "bowl=", 5) == 0) {
+            p->bowling = (uint8_t)player_rating(atoi(field + 5));
+        } else {
+            break;
+        }
+        end = field;
+        while (end > start && (end[-1] == ' ' || end[-1] == '\t')) end--;
+        *end = '\0';
+    }
+    if (end > start && end[-1] == '*') {
+        p->is_bowler = 1;
+        *--end = '\0';
+        while (end > start && (end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+    }
+    copy_name(name, start);
+}
+
+/* Roster file: first line is the team name, then one player per line.
+   A trailing '*' marks the player as a bowler and optional bat=N and
+   bowl=N after it set the ratings (1-99); '#' starts a comment. */
+int load_roster(const char* path, Team* team) {
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+    
+    char line[128];
+    int have_name = 0;
+    
+    memset(team, 0, sizeof(*team));
+    
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = 0;
+        
+        char* start = line;
+        while (*start == ' ' || *start == '\t') start++;
+        if (*start == '\0' || *start == '#') continue;
+        
+        char* end = start + strlen(start);
+        while (end > start && (end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+        
+        if (!have_name) {
+            if (!copy_name(team->name, start)) {
+                fprintf(stderr, "%s: team name longer than %d characters, using '%s'\n",
+                        path, MAX_NAME_LENGTH - 1, team->name);
+            }
+            have_name = 1;
+            continue;
+        }
+        
+        if (team->player_count >= MAX_PLAYERS) {
+            fprintf(stderr, "%s: more than %d players, ignoring '%s'\n", path, MAX_PLAYERS, start);
+            continue;
+        }
+        
+        parse_player(start, end, &team->players[team->player_count],
+                     team->player_names[team->player_count]);
+        team->player_count++;
+    }
+    
+    fclose(file);
+    return have_name;
+}
+
+/* Same format as a roster, but with no limit on the number of players.
+   Returns the player count, or -1 if the file cannot be read. */
+int load_player_pool(const char* path, char name[MAX_NAME_LENGTH], Player** players, PlayerName** names) {
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+    
+    char line[128];
+    int have_name = 0;
+    int count = 0, capacity = 0;
+    
+    *players = NULL;
+    *names = NULL;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = 0;
+        
+        char* start = line;
+        while (*start == ' ' || *start == '\t') start++;
+        if (*start == '\0' || *start == '#') continue;
+        
+        char* end = start + strlen(start);
+        while (end > start && (end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+        
+        if (!have_name) {
+            if (!copy_name(name, start)) {
+                fprintf(stderr, "%s: pool name longer than %d characters, using '%s'\n",
+                        path, MAX_NAME_LENGTH - 1, name);
+            }
+            have_name = 1;
+            continue;
+        }
+        if (count >= MAX_POOL) {
+            fprintf(stderr, "%s: more than %d players, ignoring '%s'\n", path, MAX_POOL, start);
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            Player* grown = (Player*)realloc(*players, capacity * sizeof(Player));
+            if (grown) *players = grown;
+            PlayerName* grown_names = (PlayerName*)realloc(*names, capacity * sizeof(PlayerName));
+            if (grown_names) *names = grown_names;
+            if (!grown || !grown_names) {
+                free(*players);
+                free(*names);
+                *players = NULL;
+                *names = NULL;
+                fclose(file);
+                return -1;
+            }
+        }
+        parse_player(start, end, &(*players)[count], (*names)[count]);
+        count++;
+    }
+    
+    fclose(file);
+    if (!have_name) {
+        free(*players);
+        free(*names);
+        *players = NULL;
+        *names = NULL;
+        return -1;
+    }
+    return count;
+}
+
+/* A roster list names one roster file per line, '#' starting a comment.
+   Returns the number of sides read, or -1 if a file cannot be read. */
+int load_roster_list(const char* path, Team* sides, int max_sides) {
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+    
+    char line[FILENAME_MAX];
+    int count = 0;
+    
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = 0;
+        
+        char* start = line;
+        while (*start == ' ' || *start == '\t') start++;
+        if (*start == '\0' || *start == '#') continue;
+        
+        if (count >= max_sides) {
+            fprintf(stderr, "%s: more than %d sides, ignoring '%s'\n", path, max_sides, start);
+            continue;
+        }
+        if (!load_roster(start, &sides[count])) {
+            fprintf(stderr, "CANNOT READ ROSTER: %s\n", start);
+            fclose(file);
+            return -1;
+        }
+        count++;
+    }
+    
+    fclose(file);
+    return count;
+}
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(Rng* rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitmix64(&seed);
+    }
+    rng->draws = 0;
+}
+
+/* Stream ids are hashed before seeding, so neighbouring streams start
+   from unrelated points instead of overlapping splitmix64 sequences. */
+void rng_stream(Rng* rng, uint64_t seed, uint64_t stream) {
+    uint64_t mixed = stream;
+    rng_seed(rng, seed ^ splitmix64(&mixed));
+}
+
+static inline uint64_t rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/* xoshiro256++ by Blackman and Vigna. */
+uint64_t rng_next(Rng* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = rotl64(s[0] + s[3], 23) + s[0];
+    uint64_t t = s[1] << 17;
+    
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+#ifndef CRICMANIA_NO_STATS
+    rng->draws++;
+#endif
+    
+    return result;
+}
+
+/* Advances the generator by 2^128 draws; repeated jumps hand out
+   non-overlapping streams from one seed. */
+void rng_jump(Rng* rng) {
+    static const uint64_t jump[] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+        0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+    };
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (jump[i] & (1ULL << b)) {
+                s0 ^= rng->s[0];
+                s1 ^= rng->s[1];
+                s2 ^= rng->s[2];
+                s3 ^= rng->s[3];
+            }
+            rng_next(rng);
+        }
+    }
+    rng->s[0] = s0;
+    rng->s[1] = s1;
+    rng->s[2] = s2;
+    rng->s[3] = s3;
+}
+
+/* Unbiased integer in [0, n) from 32 random bits (Lemire's method); only
+   draws again in the rare case the first bits fall in the biased zone. */
+uint32_t rng_below(Rng* rng, uint32_t bits, uint32_t n) {
+    uint64_t product = (uint64_t)bits * n;
+    uint32_t low = (uint32_t)product;
+    
+    if (low < n) {
+        uint32_t threshold = (0u - n) % n;
+        while (low < threshold) {
+            product = (uint64_t)(uint32_t)(rng_next(rng) >> 32) * n;
+            low = (uint32_t)product;
+        }
+    }
+    return (uint32_t)(product >> 32);
+}
+
+/* Adds a finished match to the batch totals; balls are counted as they
+   are bowled. */
+static void tally_match(BatchStats* stats, const MatchState* m, int batting_first) {
+    char margin_type[20];
+    int margin;
+    int winner = decide_match_result(m, &margin, margin_type);
+    
+    stats->matches++;
+    if (winner < 0) {
+        stats->ties++;
+    } else {
+        stats->wins[winner]++;
+        if (winner == batting_first) stats->bat_first_wins++;
+    }
+    
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        stats->runs[t] += m->teams[t].total_runs;
+        stats->wickets[t] += m->teams[t].total_wickets;
+    }
+    stats->first_innings_runs += m->teams[batting_first].total_runs;
+}
+
+/* One innings of the scalar batch kernel: the same draws and model rows
+   as play_ball(), and it ends where score_ball() would, but only the
+   side's totals are kept (all tally_match() reads) and the bowler is
+   looked up once an over. With `inverse` each ball is drawn from the
+   model's cdf instead, so a better draw never gives a worse ball, and
+   every draw is xor-ed with flip. Returns the runs scored. */
+FORCE_INLINE int batch_innings(MatchState* m, Rng* rng, int bat, int target, int max_balls,
+                               int inverse, uint64_t flip, BatchStats* stats) {
+    const AliasSampler* sampler = m->model->sampler;
+    const uint8_t* bowlers = m->plan.bowlers[1 - bat];
+    int bowler_count = m->plan.bowler_count[1 - bat];
+    int all_out = m->plan.all_out[bat];
+    int runs = 0, wickets = 0, balls = 0, boundaries = 0;
+    int next = 0;
+    
+    for (int over = 0; over < max_balls / 6; over++) {
+        int bowler = bowlers[next];
+        next = next + 1 < bowler_count ? next + 1 : 0;
+        
+        for (int k = 0; k < 6; k++) {
+            int row = m->matchup[bat][wickets][bowler];
+            uint64_t draw = rng_next(rng) ^ flip;
+            int outcome;
+            if (inverse) {
+                const uint64_t* cdf = m->model->cdf[row];
+                int v = 0;
+                for (int j = 0; j < OUTCOMES - 1; j++) v += (draw >> 32) >= cdf[j];
+                outcome = outcome_by_value[v];
+            } else {
+                const AliasSampler* s = &sampler[row];
+                int column = (int)(((draw >> 32) * OUTCOMES) >> 32);
+                outcome = (uint32_t)draw < s->keep[column] ? column : s->alias[column];
+            }
+            
+            runs += outcome_runs[outcome];
+            wickets += outcome_wicket[outcome];
+            boundaries += outcome == 4 || outcome == 6;
+            balls++;
+            if (wickets >= all_out || runs > target) break;
+        }
+        if (wickets >= all_out || runs > target) break;
+    }
+    
+    m->teams[bat].total_runs = runs;
+    m->teams[bat].total_wickets = wickets;
+    m->teams[bat].total_balls = balls;
+    stats->balls += balls;
+    stats->boundaries += boundaries;
+    return runs;
+}
+
+/* Plays matches first .. first + count - 1 of innings of max_balls balls.
+   The format kernels below pass a constant, so each copy is compiled with
+   a fixed over count and folded thresholds. */
+FORCE_INLINE void batch_matches(MatchState* m, long first, long count, uint64_t seed,
+                                BatchStats* stats, int max_balls) {
+    for (long n = first; n < first + count; n++) {
+        STATS_START(start);
+        rng_stream(&m->rng, seed, (uint64_t)n);
+        int batting_first = (int)(rng_next(&m->rng) >> 63);
+        
+        Rng rng = m->rng;
+        int target = batch_innings(m, &rng, batting_first, INT_MAX, max_balls, 0, 0, stats);
+        batch_innings(m, &rng, 1 - batting_first, target, max_balls, 0, 0, stats);
+        m->rng = rng;
+        m->currently_batting = 1 - batting_first;
+        m->first_innings = 0;
+        m->match_over = 1;
+        
+        tally_match(stats, m, batting_first);
+        STATS_MATCH(stats, start, m->rng.draws);
+    }
+}
+
+static void batch_house(MatchState* m, long first, long count, uint64_t seed, BatchStats* stats) {
+    batch_matches(m, first, count, seed, stats, DEFAULT_OVERS * 6);
+}
+
+static void batch_t10(MatchState* m, long first, long count, uint64_t seed, BatchStats* stats) {
+    batch_matches(m, first, count, seed, stats, 10 * 6);
+}
+
+static void batch_t20(MatchState* m, long first, long count, uint64_t seed, BatchStats* stats) {
+    batch_matches(m, first, count, seed, stats, 20 * 6);
+}
+
+static void batch_odi(MatchState* m, long first, long count, uint64_t seed, BatchStats* stats) {
+    batch_matches(m, first, count, seed, stats, 50 * 6);
+}
+
+static void batch_any(MatchState* m, long first, long count, uint64_t seed, BatchStats* stats) {
+    batch_matches(m, first, count, seed, stats, m->plan.max_balls);
+}
+
+/* The house default, T10, T20 and one-day matches have kernels of their
+   own; any other length runs the generic copy. */
+static FormatKernel format_kernel_for(const MatchPlan* plan) {
+    switch (plan->max_balls) {
+        case DEFAULT_OVERS * 6: return batch_house;
+        case 10 * 6: return batch_t10;
+        case 20 * 6: return batch_t20;
+        case 50 * 6: return batch_odi;
+        default: return batch_any;
+    }
+}
+
+/* Without a log, and with a bowler on each side, the batch runs the
+   format kernel; otherwise every ball goes through play_ball(). */
+void run_batch(MatchState* m, long first, long count, uint64_t seed, BatchStats* stats, LogBlock* events) {
+    BallResult result;
+    
+    if (!events && m->plan.bowler_count[0] > 0 && m->plan.bowler_count[1] > 0) {
+        format_kernel_for(&m->plan)(m, first, count, seed, stats);
+        return;
+    }
+    
+    for (long n = first; n < first + count; n++) {
+        STATS_START(start);
+        reset_match_state(m);
+        rng_stream(&m->rng, seed, (uint64_t)n);
+        m->currently_batting = (int)(rng_next(&m->rng) >> 63);
+        int batting_first = m->currently_batting;
+        
+        if (events) {
+            log_begin_match(events, events->log->next_match + (uint32_t)n, m);
+            while (!m->match_over) {
+                int batting = m->currently_batting;
+                int innings = m->first_innings ? 1 : 2;
+                if (play_ball(m, &result) <= 0) break;
+                log_ball(events, innings, m->teams[batting].total_balls, &result);
+                stats->balls++;
+                stats->boundaries += result.runs == 4 || result.runs == 6;
+            }
+            log_end_match(events, m);
+        } else {
+            while (!m->match_over && play_ball(m, &result) > 0) {
+                stats->balls++;
+                stats->boundaries += result.runs == 4 || result.runs == 6;
+            }
+        }
+        
+        tally_match(stats, m, batting_first);
+        STATS_MATCH(stats, start, m->rng.draws);
+    }
+}
+
+/* Lockstep kernel: LOCKSTEP_LANES matches advance one ball at a time in
+   struct-of-arrays form so the compiler can vectorise the per-ball loop.
+   Only team totals are tracked, which is all the batch aggregates need;
+   batsman and bowler rotation never change a team total under this
+   outcome model.
+   A lane whose match finishes is refilled with the next match of the
+   chunk, keeping every lane busy until the chunk runs dry. */
+static void lockstep_start(LockstepBatch* b, int lane, uint64_t seed, long index,
+                           const uint32_t all_out[MAX_TEAMS]) {
+    Rng rng;
+    rng_stream(&rng, seed, (uint64_t)index);
+    
+    b->batting_first[lane] = (uint32_t)(rng_next(&rng) >> 63);
+    b->s0[lane] = rng.s[0];
+    b->s1[lane] = rng.s[1];
+    b->s2[lane] = rng.s[2];
+    b->s3[lane] = rng.s[3];
+    b->runs[lane] = 0;
+    b->wickets[lane] = 0;
+    b->balls[lane] = 0;
+    b->target[lane] = UINT32_MAX;
+    b->all_out[lane] = all_out[b->batting_first[lane]];
+    b->innings[lane] = 0;
+    b->boundaries[lane] = 0;
+    b->active[lane] = 1;
+}
+
+static int lockstep_step(LockstepBatch* b, uint32_t max_balls, uint64_t wicket_threshold) {
+    uint32_t any = 0;
+    
+    for (int l = 0; l < LOCKSTEP_LANES; l++) {
+        uint64_t s0 = b->s0[l], s1 = b->s1[l], s2 = b->s2[l], s3 = b->s3[l];
+        uint64_t x = rotl64(s0 + s3, 23) + s0;
+        uint64_t t = s1 << 17;
+        
+        s2 ^= s0;
+        s3 ^= s1;
+        s1 ^= s2;
+        s0 ^= s3;
+        s2 ^= t;
+        s3 = rotl64(s3, 45);
+        b->s0[l] = s0;
+        b->s1[l] = s1;
+        b->s2[l] = s2;
+        b->s3[l] = s3;
+        
+        /* High half picks 0..6 runs; the leftover fraction of that product
+           is reused for the 0..2 re-roll on wicket balls. */
+        uint64_t scaled = (x >> 32) * 7;
+        uint32_t runs = (uint32_t)(scaled >> 32);
+        uint32_t rerun = (uint32_t)(((scaled & 0xFFFFFFFFULL) * 3) >> 32);
+        uint32_t wicket = (x & 0xFFFFFFFFULL) < wicket_threshold;
+        
+        runs = (wicket & (runs > 2)) ? rerun : runs;
+        b->runs[l] += runs;
+        b->wickets[l] += wicket;
+        b->balls[l] += 1;
+        b->boundaries[l] += (runs == 4) | (runs == 6);
+        
+        uint32_t done = (b->balls[l] >= max_balls) | (b->wickets[l] >= b->all_out[l]) |
+                        (b->runs[l] > b->target[l]);
+        done &= b->active[l];
+        b->done[l] = done;
+        any |= done;
+    }
+    
+    return any != 0;
+}
+
+void run_lockstep_batch(const MatchState* base, long first, long count, uint64_t seed,
+                        BatchStats* stats) {
+    LockstepBatch* b = (LockstepBatch*)malloc(sizeof(LockstepBatch));
+    if (!b) return;
+    
+    uint32_t max_balls = (uint32_t)base->plan.max_balls;
+    uint32_t all_out[MAX_TEAMS];
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        all_out[t] = (uint32_t)base->plan.all_out[t];
+    }
+    
+    long next = first;
+    long end = first + count;
+    int active = 0;
+    
+    for (int l = 0; l < LOCKSTEP_LANES; l++) {
+        if (next < end) {
+            lockstep_start(b, l, seed, next++, all_out);
+            active++;
+        } else {
+            b->active[l] = 0;
+            b->done[l] = 0;
+        }
+    }
+    
+    while (active > 0) {
+        if (!lockstep_step(b, max_balls, base->wicket_threshold)) continue;
+        
+        for (int l = 0; l < LOCKSTEP_LANES; l++) {
+            if (!b->done[l]) continue;
+            
+            uint32_t bat_first = b->batting_first[l];
+            stats->balls += b->balls[l];
+            stats->boundaries += b->boundaries[l];
+            b->boundaries[l] = 0;
+            
+            if (b->innings[l] == 0) {
+                b->first_runs[l] = b->runs[l];
+                b->first_wickets[l] = b->wickets[l];
+                b->target[l] = b->runs[l];
+                b->all_out[l] = all_out[1 - bat_first];
+                b->runs[l] = 0;
+                b->wickets[l] = 0;
+                b->balls[l] = 0;
+                b->innings[l] = 1;
+                continue;
+            }
+            
+            stats->matches++;
+            stats->runs[bat_first] += b->first_runs[l];
+            stats->wickets[bat_first] += b->first_wickets[l];
+            stats->runs[1 - bat_first] += b->runs[l];
+            stats->wickets[1 - bat_first] += b->wickets[l];
+            stats->first_innings_runs += b->first_runs[l];
+            
+            if (b->runs[l] > b->first_runs[l]) {
+                stats->wins[1 - bat_first]++;
+            } else if (b->runs[l] < b->first_runs[l]) {
+                stats->wins[bat_first]++;
+                stats->bat_first_wins++;
+            } else {
+                stats->ties++;
+            }
+            
+            if (next < end) {
+                lockstep_start(b, l, seed, next++, all_out);
+            } else {
+                b->active[l] = 0;
+                active--;
+            }
+        }
+    }
+    
+    free(b);
+}
+
+static void merge_batch_stats(BatchStats* total, const BatchStats* part) {
+    total->matches += part->matches;
+    total->ties += part->ties;
+    total->bat_first_wins += part->bat_first_wins;
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        total->wins[t] += part->wins[t];
+        total->runs[t] += part->runs[t];
+        total->wickets[t] += part->wickets[t];
+    }
+    total->first_innings_runs += part->first_innings_runs;
+    total->balls += part->balls;
+    total->boundaries += part->boundaries;
+    total->rng_draws += part->rng_draws;
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        total->match_cycles[b] += part->match_cycles[b];
+    }
+}
+
+/* Chunks are dealt out as one contiguous range per worker. A worker drains
+   its own range first and then steals single chunks from the others; both
+   go through an atomic increment of the owner's cursor, so no locks are
+   taken while the job runs. */
+static void pool_work(ThreadPool* pool, int worker) {
+    int n = pool->thread_count;
+    
+    for (int k = 0; k < n; k++) {
+        WorkQueue* q = &pool->queues[(worker + k) % n];
+        
+        for (;;) {
+            long chunk = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED);
+            if (chunk >= q->end) break;
+            
+            long begin = chunk * pool->chunk_size;
+            long end = begin + pool->chunk_size;
+            if (end > pool->item_count) end = pool->item_count;
+            pool->task(pool->ctx, worker, begin, end);
+        }
+    }
+}
+
+static THREAD_RETURN pool_thread(void* arg) {
+    PoolWorker* self = (PoolWorker*)arg;
+    ThreadPool* pool = self->pool;
+    unsigned long seen = 0;
+    
+    for (;;) {
+        mutex_lock(&pool->lock);
+        while (!pool->shutdown && pool->generation == seen) {
+            cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->shutdown) {
+            mutex_unlock(&pool->lock);
+            break;
+        }
+        seen = pool->generation;
+        mutex_unlock(&pool->lock);
+        
+        pool_work(pool, self->index);
+        
+        mutex_lock(&pool->lock);
+        if (--pool->running == 0) cond_broadcast(&pool->idle);
+        mutex_unlock(&pool->lock);
+    }
+    
+    return THREAD_RESULT;
+}
+
+ThreadPool* pool_create(int thread_count) {
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > MAX_THREADS) thread_count = MAX_THREADS;
+    
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    if (!pool) return NULL;
+    
+    mutex_init(&pool->lock);
+    cond_init(&pool->wake);
+    cond_init(&pool->idle);
+    pool->thread_count = 1;
+    
+    /* Worker 0 is the calling thread, which joins in every pool_run(). */
+    for (int i = 1; i < thread_count; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        if (!thread_create(&pool->threads[i], pool_thread, &pool->workers[i])) break;
+        pool->thread_count++;
+    }
+    
+    return pool;
+}
+
+void pool_run(ThreadPool* pool, PoolTask task, void* ctx, long item_count, long chunk_size) {
+    if (item_count <= 0) return;
+    if (chunk_size < 1) chunk_size = 1;
+    
+    int n = pool->thread_count;
+    long chunks = (item_count + chunk_size - 1) / chunk_size;
+    
+    for (int w = 0; w < n; w++) {
+        pool->queues[w].next = chunks * w / n;
+        pool->queues[w].end = chunks * (w + 1) / n;
+    }
+    
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->chunk_size = chunk_size;
+    pool->item_count = item_count;
+    
+    mutex_lock(&pool->lock);
+    pool->running = n - 1;
+    pool->generation++;
+    cond_broadcast(&pool->wake);
+    mutex_unlock(&pool->lock);
+    
+    pool_work(pool, 0);
+    
+    mutex_lock(&pool->lock);
+    while (pool->running > 0) {
+        cond_wait(&pool->idle, &pool->lock);
+    }
+    mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(ThreadPool* pool) {
+    if (!pool) return;
+    
+    mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    cond_broadcast(&pool->wake);
+    mutex_unlock(&pool->lock);
+    
+    for (int i = 1; i < pool->thread_count; i++) {
+        thread_join(pool->threads[i]);
+    }
+    
+    cond_destroy(&pool->wake);
+    cond_destroy(&pool->idle);
+    mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+static void batch_task(void* ctx, int worker, long begin, long end) {
+    BatchJob* job = (BatchJob*)ctx;
+    BatchStats part;
+    
+    memset(&part, 0, sizeof(part));
+    STATS_START(start);
+    if (job->kernel == KERNEL_LOCKSTEP) {
+        run_lockstep_batch(job->base, begin, end - begin, job->seed, &part);
+    } else {
+        run_batch(&job->states[worker], begin, end - begin, job->seed, &part,
+                  job->events ? &job->events[worker] : NULL);
+    }
+    STATS_CHUNK(&part, job->kernel == KERNEL_SCALAR, start);
+    merge_batch_stats(&job->results[worker].stats, &part);
+}
+
+/* Each match seeds its generator from its own index, so the totals do not
+   depend on how many threads ran or which chunks they stole. */
+void run_parallel_batch(ThreadPool* pool, const MatchState* base, long matches,
+                        uint64_t seed, BatchKernel kernel, BatchStats* total, EventLog* log) {
+    int n = pool->thread_count;
+    BatchJob job;
+    
+    /* The lockstep kernel samples the base distribution for every ball,
+       which is only right when no player is rated above another. */
+    if (kernel == KERNEL_LOCKSTEP && !match_is_uniform(base)) kernel = KERNEL_SCALAR;
+    
+    job.base = base;
+    job.seed = seed;
+    job.kernel = kernel;
+    job.states = (MatchState*)malloc(n * sizeof(MatchState));
+    job.results = (WorkerStats*)calloc(n, sizeof(WorkerStats));
+    job.events = log ? (LogBlock*)calloc(n, sizeof(LogBlock)) : NULL;
+    if (!job.states || !job.results || (log && !job.events)) {
+        free(job.states);
+        free(job.results);
+        free(job.events);
+        return;
+    }
+    for (int w = 0; w < n; w++) {
+        job.states[w] = *base;
+    }
+    
+    /* Every worker fills its own block and only takes the log's lock to
+       append a full one. */
+    if (log) {
+        uint32_t roster[MAX_TEAMS];
+        for (int t = 0; t < MAX_TEAMS; t++) {
+            roster[t] = event_log_roster(log, &base->teams[t]);
+        }
+        for (int w = 0; w < n; w++) {
+            if (!log_block_init(&job.events[w], log, base->config.max_overs)) {
+                for (int i = 0; i <= w; i++) log_block_free(&job.events[i]);
+                free(job.states);
+                free(job.results);
+                free(job.events);
+                __atomic_store_n(&log->failed, 1, __ATOMIC_RELAXED);
+                return;
+            }
+            memcpy(job.events[w].roster, roster, sizeof(roster));
+        }
+    }
+    
+    long chunk = matches / (n * 64L);
+    if (chunk < 256) chunk = 256;
+    pool_run(pool, batch_task, &job, matches, chunk);
+    
+    for (int w = 0; w < n; w++) {
+        merge_batch_stats(total, &job.results[w].stats);
+    }
+    
+    if (log) {
+        for (int w = 0; w < n; w++) {
+            log_block_flush(&job.events[w]);
+            log_block_free(&job.events[w]);
+        }
+        log->next_match += (uint32_t)matches;
+    }
+    
+    free(job.states);
+    free(job.results);
+    free(job.events);
+}
+
+static void rollout_task(void* ctx, int worker, long begin, long end) {
+    RolloutJob* job = (RolloutJob*)ctx;
+    RolloutStats* stats = &job->results[worker];
+    MatchState* r = &job->states[worker];
+    BallResult result;
+    
+    for (long n = begin; n < end; n++) {
+        *r = *job->snapshot;
+        rng_stream(&r->rng, job->seed, (uint64_t)(job->first + n));
+        
+        while (!r->match_over && play_ball(r, &result) > 0) {
+        }
+        
+        char margin_type[20];
+        int margin;
+        int winner = decide_match_result(r, &margin, margin_type);
+        
+        stats->rollouts++;
+        if (winner < 0) {
+            stats->ties++;
+        } else {
+            stats->wins[winner]++;
+        }
+        for (int t = 0; t < MAX_TEAMS; t++) {
+            double runs = r->teams[t].total_runs;
+            stats->runs[t] += runs;
+            stats->runs_sq[t] += runs * runs;
+        }
+    }
+}
+
+/* Plays copies of the snapshot to the end in rounds until the time budget
+   is spent. Rollout n always uses stream n of a seed peeked from the
+   snapshot's generator, so the live match is never advanced and the same
+   state gives the same prediction. Returns the number of rollouts. */
+long run_rollouts(ThreadPool* pool, const MatchState* snapshot, double budget, RolloutStats* total) {
+    int n = pool->thread_count;
+    RolloutJob job;
+    Rng peek = snapshot->rng;
+    
+    job.snapshot = snapshot;
+    job.seed = rng_next(&peek);
+    job.first = 0;
+    job.states = (MatchState*)malloc(n * sizeof(MatchState));
+    job.results = (RolloutStats*)calloc(n, sizeof(RolloutStats));
+    if (!job.states || !job.results) {
+        free(job.states);
+        free(job.results);
+        return 0;
+    }
+    
+    long round = (long)ROLLOUT_ROUND * n;
+    double start = now_seconds();
+    do {
+        pool_run(pool, rollout_task, &job, round, 64);
+        job.first += round;
+    } while (now_seconds() - start < budget && job.first < MAX_ROLLOUTS);
+    
+    memset(total, 0, sizeof(*total));
+    for (int w = 0; w < n; w++) {
+        total->rollouts += job.results[w].rollouts;
+        total->ties += job.results[w].ties;
+        for (int t = 0; t < MAX_TEAMS; t++) {
+            total->wins[t] += job.results[w].wins[t];
+            total->runs[t] += job.results[w].runs[t];
+            total->runs_sq[t] += job.results[w].runs_sq[t];
+        }
+    }
+    
+    free(job.states);
+    free(job.results);
+    return total->rollouts;
+}
+
+void show_win_prediction(const MatchState* m) {
+    if (game_pool == NULL) {
+        game_pool = pool_create(game_threads > 0 ? game_threads : cpu_count());
+        if (game_pool == NULL) {
+            printf(RED "CANNOT START THREAD POOL!\n" RESET);
+            return;
+        }
+    }
+    
+    RolloutStats stats;
+    double start = now_seconds();
+    long n = run_rollouts(game_pool, m, ROLLOUT_BUDGET, &stats);
+    double elapsed = now_seconds() - start;
+    if (n == 0) {
+        printf(RED "NOT ENOUGH MEMORY TO PREDICT THE RESULT!\n" RESET);
+        return;
+    }
+    
+    printf(CYAN "\n╔═════════════ WIN PROBABILITY ═════════════╗\n" RESET);
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        double p = (double)stats.wins[t] / n;
+        printf("%-20s %6.2f%% (±%.2f%%)\n", m->teams[t].name,
+               100.0 * p, 196.0 * sqrt(p * (1.0 - p) / n));
+    }
+    double tie = (double)stats.ties / n;
+    printf("%-20s %6.2f%% (±%.2f%%)\n", "TIE", 100.0 * tie, 196.0 * sqrt(tie * (1.0 - tie) / n));
+    
+    printf(YELLOW "\nPROJECTED SCORES:\n" RESET);
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        double mean = stats.runs[t] / n;
+        double var = stats.runs_sq[t] / n - mean * mean;
+        double half = 1.96 * sqrt((var > 0 ? var : 0.0) / n);
+        printf("%-20s %7.1f (95%% CI %.1f - %.1f)\n", m->teams[t].name, mean, mean - half, mean + half);
+    }
+    printf("\n%ld ROLLOUTS IN %.1f ms\n", n, elapsed * 1e3);
+}
+
+/* Plays match `stream` of an estimate. The toss and each side's batting
+   draw from streams of their own, so a change to one side leaves the
+   other's balls where they were and two setups compared on the same
+   stream stay in step. flip mirrors every draw, toss included. */
+static void estimate_match(MatchState* m, uint64_t seed, uint64_t stream, uint64_t flip, BatchStats* stats) {
+    Rng toss;
+    Rng batting[MAX_TEAMS];
+    
+    rng_stream(&toss, seed, 3 * stream);
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        rng_stream(&batting[t], seed, 3 * stream + 1 + t);
+    }
+    
+    int first = (int)((rng_next(&toss) ^ flip) >> 63);
+    int target = batch_innings(m, &batting[first], first, INT_MAX, m->plan.max_balls, 1, flip, stats);
+    batch_innings(m, &batting[1 - first], 1 - first, target, m->plan.max_balls, 1, flip, stats);
+}
+
+static void estimate_task(void* ctx, int worker, long begin, long end) {
+    EstimateJob* job = (EstimateJob*)ctx;
+    EstimateStats* e = &job->results[worker];
+    BatchStats balls;
+    
+    memset(&balls, 0, sizeof(balls));
+    for (long n = begin; n < end; n++) {
+        long long x[2][2] = {{0, 0}, {0, 0}};
+        
+        for (int s = 0; s < job->setup_count; s++) {
+            MatchState* m = &job->states[2 * worker + s];
+            for (int c = 0; c < job->copies; c++) {
+                char margin_type[20];
+                int margin;
+                estimate_match(m, job->seed, (uint64_t)(job->first + n), c ? ~0ULL : 0, &balls);
+                int winner = decide_match_result(m, &margin, margin_type);
+                long long runs = m->teams[0].total_runs - m->teams[1].total_runs;
+                
+                e->ties[s] += winner < 0;
+                e->match_sq[s][0] += winner == 0;
+                e->match_sq[s][1] += runs * runs;
+                x[s][0] += winner == 0;
+                x[s][1] += runs;
+            }
+        }
+        for (int v = 0; v < 2; v++) {
+            for (int s = 0; s < job->setup_count; s++) {
+                e->sum[s][v] += x[s][v];
+                e->sq[s][v] += x[s][v] * x[s][v];
+            }
+            long long change = x[1][v] - x[0][v];
+            e->sum[2][v] += change;
+            e->sq[2][v] += change * change;
+        }
+        e->samples++;
+    }
+    e->balls += balls.balls;
+}
+
+/* Mean per match of sum[s][v], and the half-width of its 95% interval
+   from the spread between samples. */
+static double estimate_mean(const EstimateStats* e, int copies, int s, int v, double* half) {
+    double n = (double)e->samples;
+    double mean = e->sum[s][v] / n;
+    double var = e->sq[s][v] / n - mean * mean;
+    
+    *half = 1.96 * sqrt((var > 0 ? var : 0.0) / n) / copies;
+    return mean / copies;
+}
+
+/* How many times the variance of plain sampling, one independent match
+   per sample and setup, is that of the estimate at the same match count. */
+static double estimate_gain(const EstimateStats* e, int copies, int s, int v, double half) {
+    double matches = (double)e->samples * copies;
+    double plain = 0.0;
+    
+    for (int k = (s == 2 ? 0 : s); k <= (s == 2 ? 1 : s); k++) {
+        double mean = e->sum[k][v] / matches;
+        plain += e->match_sq[k][v] / matches - mean * mean;
+    }
+    double var = half / 1.96;
+    var *= var;
+    return var > 0 ? plain / matches / var : 0.0;
+}
+
+/* Plays the setups in rounds of ESTIMATE_ROUND samples, every sample on
+   the same streams in each setup, until the 95% interval on team 1's win
+   probability (or its change, when comparing) is at most ±ci or the
+   setups have played max_matches matches each. */
+static int run_estimate(ThreadPool* pool, const MatchState* base, const MatchState* alt, long max_matches,
+                        uint64_t seed, double ci, int antithetic) {
+    int n = pool->thread_count;
+    EstimateJob job;
+    
+    job.setups[0] = base;
+    job.setups[1] = alt;
+    job.setup_count = alt ? 2 : 1;
+    job.copies = antithetic ? 2 : 1;
+    job.seed = seed;
+    job.first = 0;
+    job.states = (MatchState*)malloc(2 * n * sizeof(MatchState));
+    job.results = (EstimateStats*)calloc(n, sizeof(EstimateStats));
+    if (!job.states || !job.results) {
+        fprintf(stderr, "NOT ENOUGH MEMORY FOR THE ESTIMATE\n");
+        free(job.states);
+        free(job.results);
+        return 1;
+    }
+    for (int w = 0; w < n; w++) {
+        for (int s = 0; s < job.setup_count; s++) job.states[2 * w + s] = *job.setups[s];
+    }
+    
+    int primary = alt ? 2 : 0;
+    long max_samples = max_matches / job.copies;
+    if (max_samples < 1) max_samples = 1;
+    EstimateStats total;
+    double half = 0.0;
+    int rounds = 0;
+    double start = now_seconds();
+    
+    do {
+        long round = max_samples - job.first < ESTIMATE_ROUND ? max_samples - job.first : ESTIMATE_ROUND;
+        pool_run(pool, estimate_task, &job, round, 64);
+        job.first += round;
+        rounds++;
+        
+        memset(&total, 0, sizeof(total));
+        for (int w = 0; w < n; w++) {
+            const EstimateStats* r = &job.results[w];
+            total.samples += r->samples;
+            total.balls += r->balls;
+            for (int s = 0; s < 3; s++) {
+                for (int v = 0; v < 2; v++) {
+                    total.sum[s][v] += r->sum[s][v];
+                    total.sq[s][v] += r->sq[s][v];
+                    if (s < 2) total.match_sq[s][v] += r->match_sq[s][v];
+                }
+                if (s < 2) total.ties[s] += r->ties[s];
+            }
+        }
+        estimate_mean(&total, job.copies, primary, 0, &half);
+    } while (job.first < max_samples && !(ci > 0 && 100.0 * half <= ci));
+    double elapsed = now_seconds() - start;
+    
+    long matches = total.samples * job.copies;
+    printf("ESTIMATE: %ld MATCHES PER SETUP IN %d ROUND%s (%d OVERS, WICKET PROBABILITY %.3f)%s\n",
+           matches, rounds, rounds == 1 ? "" : "S", base->config.max_overs, base->config.wicket_probability,
+           antithetic ? ", ANTITHETIC PAIRS" : "");
+    if (ci > 0) {
+        printf(100.0 * half <= ci ? "STOPPED AT ±%.2f%% (TARGET ±%.2f%%)\n"
+                                  : "STOPPED AT THE --batch LIMIT: ±%.2f%% (TARGET ±%.2f%%)\n",
+               100.0 * half, ci);
+    }
+    if (alt) {
+        printf("BASE:    %s vs %s\n", base->teams[0].name, base->teams[1].name);
+        printf("COMPARE: %s vs %s (WICKET PROBABILITY %.3f)\n",
+               alt->teams[0].name, alt->teams[1].name, alt->config.wicket_probability);
+    }
+    
+    const char* labels[2] = {"TEAM 1 WIN %", "TEAM 1 RUN MARGIN"};
+    const double scale[2] = {100.0, 1.0};
+    printf("%-20s %10s %10s %10s %10s %10s\n", "", "BASE", alt ? "COMPARE" : "", alt ? "CHANGE" : "",
+           "95% CI", "VAR CUT");
+    for (int v = 0; v < 2; v++) {
+        double value[3], h[3];
+        for (int s = 0; s < 3; s++) {
+            value[s] = scale[v] * estimate_mean(&total, job.copies, s, v, &h[s]);
+        }
+        printf("%-20s %10.2f", labels[v], value[0]);
+        if (alt) {
+            printf(" %10.2f %+10.2f", value[1], value[2]);
+        } else {
+            printf(" %10s %10s", "", "");
+        }
+        char interval[32];
+        snprintf(interval, sizeof(interval), "±%.2f", scale[v] * h[primary]);
+        printf(" %11s %9.1fx\n", interval, estimate_gain(&total, job.copies, primary, v, h[primary]));
+    }
+    printf("%-20s %10.2f", "TIE %", 100.0 * total.ties[0] / matches);
+    if (alt) printf(" %10.2f", 100.0 * total.ties[1] / matches);
+    printf("\n");
+    printf("SEED: %llu\n", (unsigned long long)seed);
+    printf("THREADS: %d  BALLS: %lld  TIME: %.3fs  MATCHES/SEC: %.0f\n", n, total.balls, elapsed,
+           elapsed > 0 ? matches * job.setup_count / elapsed : 0.0);
+    
+    free(job.states);
+    free(job.results);
+    return 0;
+}
+
+static int group_first(const Tournament* t, int group) {
+    return group * t->side_count / t->group_count;
+}
+
+/* Round robin by the circle method: side 0 stays put while the rest
+   rotate, so each round pairs every side once (a dummy side gives odd
+   groups a bye). Round r of every group is tournament round r, and the
+   fixtures are stored round by round. */
+static int tournament_fixtures(Tournament* t) {
+    int largest = 0;
+    
+    t->fixture_count = 0;
+    for (int g = 0; g < t->group_count; g++) {
+        int n = group_first(t, g + 1) - group_first(t, g);
+        if (n > largest) largest = n;
+        t->fixture_count += n * (n - 1) / 2;
+    }
+    t->round_count = largest + (largest & 1) - 1;
+    t->fixtures = (Fixture*)malloc((t->fixture_count + 1) * sizeof(Fixture));
+    if (!t->fixtures) return 0;
+    
+    int count = 0;
+    for (int r = 0; r < t->round_count; r++) {
+        for (int g = 0; g < t->group_count; g++) {
+            int first = group_first(t, g);
+            int n = group_first(t, g + 1) - first;
+            int slots = n + (n & 1);
+            if (r >= slots - 1) continue;
+            
+            for (int i = 0; i < slots / 2; i++) {
+                int a = i == 0 ? 0 : 1 + (i - 1 + r) % (slots - 1);
+                int b = 1 + (slots - 2 - i + r) % (slots - 1);
+                if (a >= n || b >= n) continue;
+                if ((r + i) & 1) {
+                    int swap = a;
+                    a = b;
+                    b = swap;
+                }
+                
+                Fixture* f = &t->fixtures[count++];
+                f->home = (uint16_t)(first + a);
+                f->away = (uint16_t)(first + b);
+                f->round = (uint16_t)r;
+                f->group = (uint16_t)g;
+            }
+        }
+    }
+    
+    t->streams = t->fixture_count + (t->qualifiers > 1 ? t->qualifiers - 1 : 0);
+    return 1;
+}
+
+/* Checks the format and builds the group-stage fixtures. Sides are split
+   into groups in order: group g holds a contiguous run of sides. */
+int tournament_init(Tournament* t, const Team* sides, int side_count, int group_count,
+                    int qualify, const GameConfig* cfg, const OutcomeModel* model, uint64_t seed) {
+    memset(t, 0, sizeof(*t));
+    t->sides = sides;
+    t->side_count = side_count;
+    t->group_count = group_count;
+    t->qualify = qualify;
+    t->qualifiers = group_count * qualify;
+    t->config = *cfg;
+    t->model = model;
+    t->seed = seed;
+    
+    if (side_count < 2 || side_count > MAX_SIDES) {
+        fprintf(stderr, "A TOURNAMENT NEEDS 2 TO %d SIDES\n", MAX_SIDES);
+        return 0;
+    }
+    if (group_count < 1 || side_count / group_count < 2) {
+        fprintf(stderr, "EVERY GROUP NEEDS AT LEAST 2 SIDES\n");
+        return 0;
+    }
+    if (qualify < 0 || qualify > side_count / group_count ||
+        (qualify == 0 && group_count > 1) || (t->qualifiers & (t->qualifiers - 1)) != 0) {
+        fprintf(stderr, "GROUPS x QUALIFY MUST BE A POWER OF TWO AND EVERY GROUP MUST HAVE QUALIFY SIDES\n");
+        return 0;
+    }
+    if (t->qualifiers == 1) t->qualifiers = 0;
+    
+    if (!tournament_fixtures(t)) {
+        fprintf(stderr, "NOT ENOUGH MEMORY FOR THE FIXTURES\n");
+        return 0;
+    }
+    return 1;
+}
+
+void tournament_free(Tournament* t) {
+    free(t->fixtures);
+    t->fixtures = NULL;
+}
+
+/* Knockout ties go to a super over: one over and two wickets a side, the
+   side that batted second going first, repeated while it stays level.
+   Each side sends in its top two batsmen against its first bowler. */
+static int super_over(MatchState* m, int batting_first) {
+    BallResult ball;
+    char margin_type[20];
+    int margin;
+    
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        Team* team = &m->teams[t];
+        int bowler = 0;
+        while (bowler < team->player_count - 1 && !team->players[bowler].is_bowler) bowler++;
+        team->players[2] = team->players[bowler];
+        team->players[0].is_bowler = 0;
+        team->players[1].is_bowler = 0;
+        team->players[2].is_bowler = 1;
+        team->player_count = 3;
+    }
+    m->config.max_overs = 1;
+    match_prepare(m);
+    
+    for (int attempt = 0; attempt < SUPER_OVER_LIMIT; attempt++) {
+        reset_match_state(m);
+        m->currently_batting = 1 - batting_first;
+        while (!m->match_over && play_ball(m, &ball) > 0) {
+        }
+        int winner = decide_match_result(m, &margin, margin_type);
+        if (winner >= 0) return winner;
+    }
+    return (int)(rng_next(&m->rng) >> 63);
+}
+
+static void play_fixture(MatchState* m, const Tournament* t, const Fixture* f,
+                         uint64_t stream, int knockout, FixtureResult* r) {
+    BallResult ball;
+    char margin_type[20];
+    int margin;
+    
+    m->config = t->config;
+    m->teams[0] = t->sides[f->home];
+    m->teams[1] = t->sides[f->away];
+    match_prepare(m);
+    reset_match_state(m);
+    rng_stream(&m->rng, t->seed, stream);
+    m->currently_batting = (int)(rng_next(&m->rng) >> 63);
+    int batting_first = m->currently_batting;
+    
+    while (!m->match_over && play_ball(m, &ball) > 0) {
+    }
+    
+    r->winner = decide_match_result(m, &margin, margin_type);
+    r->super_over = 0;
+    for (int s = 0; s < MAX_TEAMS; s++) {
+        const Team* team = &m->teams[s];
+        r->runs[s] = team->total_runs;
+        r->wickets[s] = team->total_wickets;
+        /* Net run rate charges a side bowled out with its full quota. */
+        r->balls[s] = team->total_wickets >= team->player_count - 1
+                      ? m->config.max_overs * 6 : team->total_balls;
+    }
+    if (r->winner < 0 && knockout) {
+        r->winner = super_over(m, batting_first);
+        r->super_over = 1;
+    }
+}
+
+static void stage_task(void* ctx, int worker, long begin, long end) {
+    StageJob* job = (StageJob*)ctx;
+    MatchState* m = &job->works[worker].state;
+    
+    for (long i = begin; i < end; i++) {
+        play_fixture(m, job->t, &job->fixtures[i], job->stream + (uint64_t)i,
+                     job->knockout, &job->results[i]);
+    }
+}
+
+/* No fixture of a stage depends on another, so with a pool the whole
+   stage is spread across its workers at once. */
+static void run_stage(const Tournament* t, ThreadPool* pool, TournamentWork* works, int worker,
+                      const Fixture* fixtures, FixtureResult* results, int count,
+                      uint64_t stream, int knockout) {
+    StageJob job;
+    
+    job.t = t;
+    job.works = works;
+    job.fixtures = fixtures;
+    job.results = results;
+    job.stream = stream;
+    job.knockout = knockout;
+    
+    if (pool) {
+        long chunk = count / (pool->thread_count * 8L);
+        pool_run(pool, stage_task, &job, count, chunk < 1 ? 1 : chunk);
+    } else {
+        stage_task(&job, worker, 0, count);
+    }
+}
+
+static int compare_standing(const void* a, const void* b) {
+    const TableRow* x = (const TableRow*)a;
+    const TableRow* y = (const TableRow*)b;
+    
+    if (x->points != y->points) return y->points - x->points;
+    if (x->nrr != y->nrr) return x->nrr < y->nrr ? 1 : -1;
+    if (x->won != y->won) return y->won - x->won;
+    return x->side - y->side;
+}
+
+/* Two points for a win and one for a tie; level sides are split by net
+   run rate, then wins. Each group's rows end up in finishing order. */
+static void tournament_table(const Tournament* t, const FixtureResult* results, TableRow* table) {
+    memset(table, 0, t->side_count * sizeof(TableRow));
+    for (int i = 0; i < t->side_count; i++) {
+        table[i].side = i;
+    }
+    
+    for (int i = 0; i < t->fixture_count; i++) {
+        const FixtureResult* r = &results[i];
+        int side[MAX_TEAMS] = {t->fixtures[i].home, t->fixtures[i].away};
+        
+        for (int s = 0; s < MAX_TEAMS; s++) {
+            TableRow* row = &table[side[s]];
+            row->played++;
+            row->runs_for += r->runs[s];
+            row->balls_for += r->balls[s];
+            row->runs_against += r->runs[1 - s];
+            row->balls_against += r->balls[1 - s];
+            if (r->winner < 0) {
+                row->tied++;
+                row->points += 1;
+            } else if (r->winner == s) {
+                row->won++;
+                row->points += 2;
+            } else {
+                row->lost++;
+            }
+        }
+    }
+    
+    for (int i = 0; i < t->side_count; i++) {
+        TableRow* row = &table[i];
+        double scored = row->balls_for > 0 ? 6.0 * row->runs_for / row->balls_for : 0.0;
+        double conceded = row->balls_against > 0 ? 6.0 * row->runs_against / row->balls_against : 0.0;
+        row->nrr = scored - conceded;
+    }
+    for (int g = 0; g < t->group_count; g++) {
+        int first = group_first(t, g);
+        qsort(&table[first], group_first(t, g + 1) - first, sizeof(TableRow), compare_standing);
+    }
+}
+
+/* Plays one whole tournament into works[worker]. Fixture i of run r always
+   draws from stream r * t->streams + i, so the outcome depends only on the
+   seed and the run, never on the pool or the thread count. */
+void tournament_play(const Tournament* t, TournamentWork* works, int worker, long run, ThreadPool* pool) {
+    TournamentWork* w = &works[worker];
+    uint64_t stream = (uint64_t)run * (uint64_t)t->streams;
+    
+    run_stage(t, pool, works, worker, t->fixtures, w->results, t->fixture_count, stream, 0);
+    tournament_table(t, w->results, w->table);
+    
+    if (t->qualifiers == 0) {
+        w->champion = w->table[0].side;
+        return;
+    }
+    
+    /* Group winners are seeded first, then runners-up and so on. Every
+       round pairs the best remaining seed with the worst. */
+    int alive = 0;
+    for (int rank = 0; rank < t->qualify; rank++) {
+        for (int g = 0; g < t->group_count; g++) {
+            w->bracket[alive] = w->table[group_first(t, g) + rank].side;
+            w->alive[alive] = w->bracket[alive];
+            alive++;
+        }
+    }
+    
+    int played = 0;
+    for (int round = t->round_count; alive > 1; round++) {
+        int pairs = alive / 2;
+        Fixture* f = &w->knockout[played];
+        FixtureResult* r = &w->results[t->fixture_count + played];
+        
+        for (int i = 0; i < pairs; i++) {
+            f[i].home = (uint16_t)w->alive[i];
+            f[i].away = (uint16_t)w->alive[alive - 1 - i];
+            f[i].round = (uint16_t)round;
+            f[i].group = 0;
+        }
+        run_stage(t, pool, works, worker, f, r, pairs, stream + t->fixture_count + played, 1);
+        for (int i = 0; i < pairs; i++) {
+            w->alive[i] = r[i].winner == 0 ? f[i].home : f[i].away;
+        }
+        
+        played += pairs;
+        alive = pairs;
+    }
+    w->champion = w->alive[0];
+}
+
+static void tournament_work_free(TournamentWork* works, int count) {
+    for (int i = 0; i < count; i++) {
+        free(works[i].results);
+        free(works[i].knockout);
+        free(works[i].table);
+        free(works[i].bracket);
+        free(works[i].alive);
+        free(works[i].qualified);
+        free(works[i].finals);
+        free(works[i].titles);
+        free(works[i].points);
+    }
+    free(works);
+}
+
+static TournamentWork* tournament_work_alloc(const Tournament* t, int count) {
+    TournamentWork* works = (TournamentWork*)calloc(count, sizeof(TournamentWork));
+    if (!works) return NULL;
+    
+    int qualifiers = t->qualifiers > 1 ? t->qualifiers : 1;
+    for (int i = 0; i < count; i++) {
+        TournamentWork* w = &works[i];
+        match_init_model(&w->state, t->sides, &t->config, t->model);
+        w->results = (FixtureResult*)malloc((t->streams + 1) * sizeof(FixtureResult));
+        w->knockout = (Fixture*)malloc(qualifiers * sizeof(Fixture));
+        w->table = (TableRow*)malloc(t->side_count * sizeof(TableRow));
+        w->bracket = (int*)malloc(qualifiers * sizeof(int));
+        w->alive = (int*)malloc(qualifiers * sizeof(int));
+        w->qualified = (long*)calloc(t->side_count, sizeof(long));
+        w->finals = (long*)calloc(t->side_count, sizeof(long));
+        w->titles = (long*)calloc(t->side_count, sizeof(long));
+        w->points = (long long*)calloc(t->side_count, sizeof(long long));
+        if (!w->results || !w->knockout || !w->table || !w->bracket || !w->alive ||
+            !w->qualified || !w->finals || !w->titles || !w->points) {
+            tournament_work_free(works, i + 1);
+            return NULL;
+        }
+    }
+    return works;
+}
+
+static void tournament_task(void* ctx, int worker, long begin, long end) {
+    TournamentJob* job = (TournamentJob*)ctx;
+    const Tournament* t = job->t;
+    TournamentWork* w = &job->works[worker];
+    
+    for (long run = begin; run < end; run++) {
+        tournament_play(t, job->works, worker, job->first + run, NULL);
+        
+        for (int i = 0; i < t->side_count; i++) {
+            w->points[w->table[i].side] += w->table[i].points;
+        }
+        for (int i = 0; i < t->qualifiers; i++) {
+            w->qualified[w->bracket[i]]++;
+        }
+        if (t->qualifiers > 1) {
+            const Fixture* final = &w->knockout[t->qualifiers - 2];
+            w->finals[final->home]++;
+            w->finals[final->away]++;
+        }
+        w->titles[w->champion]++;
+    }
+}
+
+static const char* knockout_round_name(int sides, char* buffer, size_t size) {
+    if (sides == 2) return "FINAL";
+    if (sides == 4) return "SEMI-FINALS";
+    if (sides == 8) return "QUARTER-FINALS";
+    snprintf(buffer, size, "ROUND OF %d", sides);
+    return buffer;
+}
+
+static void print_tournament(const Tournament* t, const TournamentWork* w) {
+    for (int g = 0; g < t->group_count; g++) {
+        int first = group_first(t, g);
+        int last = group_first(t, g + 1);
+        
+        if (t->group_count > 1) {
+            printf(CYAN "\nGROUP %d\n" RESET, g + 1);
+        } else {
+            printf(CYAN "\nPOINTS TABLE\n" RESET);
+        }
+        printf("%3s  %-20s %3s %3s %3s %3s %4s %8s\n", "POS", "TEAM", "P", "W", "L", "T", "PTS", "NRR");
+        for (int i = first; i < last; i++) {
+            const TableRow* row = &w->table[i];
+            int through = t->qualifiers > 0 && i - first < t->qualify;
+            printf("%s%3d  %-20s %3d %3d %3d %3d %4d %+8.3f%s\n", through ? GREEN : "",
+                   i - first + 1, t->sides[row->side].name, row->played, row->won,
+                   row->lost, row->tied, row->points, row->nrr, through ? RESET : "");
+        }
+    }
+    
+    int played = 0;
+    for (int alive = t->qualifiers; alive > 1; alive /= 2) {
+        char name[24];
+        printf(YELLOW "\n%s\n" RESET, knockout_round_name(alive, name, sizeof(name)));
+        for (int i = 0; i < alive / 2; i++, played++) {
+            const Fixture* f = &w->knockout[played];
+            const FixtureResult* r = &w->results[t->fixture_count + played];
+            int side[MAX_TEAMS] = {f->home, f->away};
+            int won = r->winner;
+            
+            printf("%-20s %3d/%-2d  BEAT  %-20s %3d/%-2d%s\n",
+                   t->sides[side[won]].name, r->runs[won], r->wickets[won],
+                   t->sides[side[1 - won]].name, r->runs[1 - won], r->wickets[1 - won],
+                   r->super_over ? "  (SUPER OVER)" : "");
+        }
+    }
+    
+    printf(GREEN "\nCHAMPIONS: %s\n" RESET, t->sides[w->champion].name);
+}
+
+static int compare_odds(const void* a, const void* b) {
+    const SideOdds* x = (const SideOdds*)a;
+    const SideOdds* y = (const SideOdds*)b;
+    
+    if (x->titles != y->titles) return x->titles < y->titles ? 1 : -1;
+    if (x->qualified != y->qualified) return x->qualified < y->qualified ? 1 : -1;
+    return x->side - y->side;
+}
+
+/* Adds every worker's counts into works[0] and lists the sides by titles,
+   then qualifications. */
+static void tournament_totals(const Tournament* t, TournamentWork* works, int workers, SideOdds* order) {
+    TournamentWork* total = &works[0];
+    
+    for (int i = 0; i < t->side_count; i++) {
+        for (int w = 1; w < workers; w++) {
+            total->qualified[i] += works[w].qualified[i];
+            total->finals[i] += works[w].finals[i];
+            total->titles[i] += works[w].titles[i];
+            total->points[i] += works[w].points[i];
+        }
+        order[i].side = i;
+        order[i].titles = total->titles[i];
+        order[i].qualified = total->qualified[i];
+    }
+    qsort(order, t->side_count, sizeof(SideOdds), compare_odds);
+}
+
+/* Plays the tournament `runs` times and prints each side's chance of
+   qualifying, reaching the final and winning it. A single run prints its
+   tables and knockout results instead. */
+int run_tournament(const Tournament* t, long runs, int threads) {
+    ThreadPool* pool = pool_create(threads);
+    if (!pool) {
+        fprintf(stderr, "CANNOT START THREAD POOL\n");
+        return 1;
+    }
+    TournamentWork* works = tournament_work_alloc(t, pool->thread_count);
+    SideOdds* order = (SideOdds*)malloc(t->side_count * sizeof(SideOdds));
+    if (!works || !order) {
+        fprintf(stderr, "NOT ENOUGH MEMORY FOR THE TOURNAMENT\n");
+        if (works) tournament_work_free(works, pool->thread_count);
+        free(order);
+        pool_destroy(pool);
+        return 1;
+    }
+    
+    /* A single tournament spreads each stage's fixtures over the pool;
+       many tournaments give each worker whole tournaments instead. */
+    double start = now_seconds();
+    if (runs == 1) {
+        tournament_play(t, works, 0, 0, pool);
+    } else {
+        TournamentJob job;
+        job.t = t;
+        job.works = works;
+        job.first = 0;
+        pool_run(pool, tournament_task, &job, runs, 1);
+    }
+    double elapsed = now_seconds() - start;
+    
+    if (runs == 1) {
+        print_tournament(t, &works[0]);
+    } else {
+        TournamentWork* total = &works[0];
+        tournament_totals(t, works, pool->thread_count, order);
+        
+        printf("%-20s %9s %9s %9s %8s\n", "TEAM", "QUALIFY", "FINAL", "TITLE", "AVG PTS");
+        for (int i = 0; i < t->side_count; i++) {
+            int s = order[i].side;
+            if (t->qualifiers > 0) {
+                printf("%-20s %8.2f%% %8.2f%% %8.2f%% %8.2f\n", t->sides[s].name,
+                       100.0 * total->qualified[s] / runs, 100.0 * total->finals[s] / runs,
+                       100.0 * total->titles[s] / runs, (double)total->points[s] / runs);
+            } else {
+                printf("%-20s %9s %9s %8.2f%% %8.2f\n", t->sides[s].name, "-", "-",
+                       100.0 * total->titles[s] / runs, (double)total->points[s] / runs);
+            }
+        }
+    }
+    
+    long long matches = (long long)runs * t->streams;
+    printf("\nSEED: %llu\n", (unsigned long long)t->seed);
+    printf("TOURNAMENTS: %ld  MATCHES: %lld  THREADS: %d  TIME: %.3fs  MATCHES/SEC: %.0f\n",
+           runs, matches, pool->thread_count, elapsed, elapsed > 0 ? matches / elapsed : 0.0);
+    
+    free(order);
+    tournament_work_free(works, pool->thread_count);
+    pool_destroy(pool);
+    return 0;
+}
+
+static void print_batch_stats(const MatchState* m, const BatchStats* stats) {
+    printf("MATCHES: %ld (%d OVERS, WICKET PROBABILITY %.3f)\n",
+           stats->matches, m->config.max_overs, m->config.wicket_probability);
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        printf("%-20s WINS %10ld (%6.2f%%)  AVG SCORE %7.2f/%.2f\n",
+               m->teams[t].name, stats->wins[t], 100.0 * stats->wins[t] / stats->matches,
+               (double)stats->runs[t] / stats->matches,
+               (double)stats->wickets[t] / stats->matches);
+    }
+    printf("%-20s      %10ld (%6.2f%%)\n", "TIES", stats->ties, 100.0 * stats->ties / stats->matches);
+    printf("BATTING FIRST WINS: %.2f%%  AVG FIRST INNINGS: %.2f  BOUNDARIES: %.2f%% OF BALLS\n",
+           100.0 * stats->bat_first_wins / stats->matches,
+           (double)stats->first_innings_runs / stats->matches,
+           stats->balls > 0 ? 100.0 * stats->boundaries / stats->balls : 0.0);
+}
+
+static void run_scaling_report(const MatchState* base, long matches, uint64_t seed,
+                               BatchKernel kernel, int max_threads) {
+    double base_rate = 0.0;
+    
+    printf("%7s %10s %14s %14s %8s %10s\n",
+           "THREADS", "TIME(s)", "MATCHES/SEC", "BALLS/SEC", "SPEEDUP", "EFFICIENCY");
+    
+    for (int n = 1; ; n = n * 2 < max_threads ? n * 2 : max_threads) {
+        ThreadPool* pool = pool_create(n);
+        if (!pool) return;
+        
+        BatchStats stats;
+        memset(&stats, 0, sizeof(stats));
+        
+        double start = now_seconds();
+        run_parallel_batch(pool, base, matches, seed, kernel, &stats, NULL);
+        double elapsed = now_seconds() - start;
+        pool_destroy(pool);
+        
+        double rate = elapsed > 0 ? stats.matches / elapsed : 0.0;
+        if (n == 1) base_rate = rate;
+        double speedup = base_rate > 0 ? rate / base_rate : 0.0;
+        
+        printf("%7d %10.3f %14.0f %14.0f %7.2fx %9.1f%%\n",
+               n, elapsed, rate, elapsed > 0 ? stats.balls / elapsed : 0.0,
+               speedup, 100.0 * speedup / n);
+        
+        if (n >= max_threads) break;
+    }
+}
+
+static void check_line(const char* label, double exact, long hits, long n) {
+    double mc = (double)hits / n;
+    double se = sqrt(exact * (1.0 - exact) / n);
+    
+    printf("%-22s %10.5f %10.5f %10.5f %8.2f\n",
+           label, exact, mc, se, se > 0 ? (mc - exact) / se : 0.0);
+}
+
+/* Compares the dynamic-programming table against a Monte Carlo batch
+   played from the first ball with a fair toss. */
+static int run_winprob_check(ThreadPool* pool, const MatchState* base, long matches,
+                             uint64_t seed, BatchKernel kernel) {
+    double start = now_seconds();
+    WinProbTable* t = winprob_build(base);
+    double build_time = now_seconds() - start;
+    if (!t) {
+        fprintf(stderr, "NOT ENOUGH MEMORY FOR THE WIN PROBABILITY TABLE\n");
+        return 1;
+    }
+    
+    WinTie first[MAX_TEAMS];
+    for (int team = 0; team < MAX_TEAMS; team++) {
+        first[team] = first_value(t, team, t->max_balls, t->all_out[team], 0);
+    }
+    
+    MatchState probe = *base;
+    float win[MAX_TEAMS], tie;
+    volatile float sink = 0.0f;
+    const long queries = 1000000;
+    start = now_seconds();
+    for (long q = 0; q < queries; q++) {
+        probe.teams[0].total_runs = (int)(q % 40);
+        probe.teams[0].total_balls = (int)(q % t->max_balls);
+        winprob_query(t, &probe, win, &tie);
+        sink += win[0];
+    }
+    double query_time = (now_seconds() - start) / queries;
+    
+    BatchStats stats;
+    memset(&stats, 0, sizeof(stats));
+    run_parallel_batch(pool, base, matches, seed, kernel, &stats, NULL);
+    
+    printf("TABLE BUILT IN %.3f ms, QUERY %.1f ns\n", build_time * 1e3, query_time * 1e9);
+    printf("%-22s %10s %10s %10s %8s\n", "OUTCOME", "EXACT", "SIMULATED", "STD ERR", "Z");
+    check_line(base->teams[0].name, 0.5 * (first[0].win + 1.0 - first[1].win - first[1].tie),
+               stats.wins[0], stats.matches);
+    check_line(base->teams[1].name, 0.5 * (first[1].win + 1.0 - first[0].win - first[0].tie),
+               stats.wins[1], stats.matches);
+    check_line("TIE", 0.5 * (first[0].tie + first[1].tie), stats.ties, stats.matches);
+    check_line("BATTING FIRST WINS", 0.5 * (first[0].win + first[1].win),
+               stats.bat_first_wins, stats.matches);
+    
+    winprob_free(t);
+    return 0;
+}
+
+static const char* calibration_names[CALIBRATION_TARGETS] = {
+    "FIRST INNINGS SCORE", "WICKETS PER INNINGS", "BOUNDARY % OF BALLS", "TIE %"
+};
+
+/* Errors are relative to the target, with a floor so that a target near
+   zero does not swamp the others. */
+static const double calibration_floor[CALIBRATION_TARGETS] = {1.0, 0.1, 1.0, 1.0};
+
+static void calibration_config(const Calibration* c, const double* x, GameConfig* cfg) {
+    *cfg = c->base.config;
+    cfg->wicket_probability = (float)(1.0 / (1.0 + exp(-x[0])));
+    memcpy(cfg->run_weights, c->start_weights, sizeof(cfg->run_weights));
+    for (int i = 0; i < c->free_count; i++) {
+        cfg->run_weights[c->free_runs[i]] = (float)exp(x[1 + i]);
+    }
+}
+
+/* Plays the whole batch under cfg. The seed, and with it every match's
+   random stream, is the same for all candidates of a fit, so the
+   difference between two candidates is not buried in sampling noise. */
+static void calibration_measure(Calibration* c, const GameConfig* cfg, uint64_t seed,
+                                double out[CALIBRATION_TARGETS]) {
+    MatchState* m = &c->base;
+    BatchStats stats;
+    
+    m->config = *cfg;
+    m->wicket_threshold = (uint64_t)(cfg->wicket_probability * 4294967296.0);
+    outcome_model_build(&c->model, cfg);
+    m->model = &c->model;
+    
+    memset(&stats, 0, sizeof(stats));
+    run_parallel_batch(c->pool, m, c->matches, seed, KERNEL_SCALAR, &stats, NULL);
+    c->evaluations++;
+    
+    long matches = stats.matches > 0 ? stats.matches : 1;
+    out[0] = (double)stats.first_innings_runs / matches;
+    out[1] = (double)(stats.wickets[0] + stats.wickets[1]) / (2.0 * matches);
+    out[2] = stats.balls > 0 ? 100.0 * stats.boundaries / stats.balls : 0.0;
+    out[3] = 100.0 * stats.ties / matches;
+}
+
+/* Relative misses for the fitted targets, then a small pull towards the
+   starting shape of the run weights, which picks one answer when the
+   targets leave the weights underdetermined. Returns the number of
+   residuals. */
+static int calibration_residuals(Calibration* c, const double* x, double* r) {
+    GameConfig cfg;
+    double got[CALIBRATION_TARGETS];
+    int n = 0;
+    
+    calibration_config(c, x, &cfg);
+    calibration_measure(c, &cfg, c->seed, got);
+    
+    for (int k = 0; k < CALIBRATION_TARGETS; k++) {
+        if (c->target[k] < 0) continue;
+        double scale = c->target[k] > calibration_floor[k] ? c->target[k] : calibration_floor[k];
+        r[n++] = (got[k] - c->target[k]) / scale;
+    }
+    
+    double shift[7], mean = 0.0;
+    shift[0] = 0.0;
+    for (int i = 0; i < c->free_count; i++) {
+        shift[1 + i] = x[1 + i] - log(c->start_weights[c->free_runs[i]]);
+        mean += shift[1 + i];
+    }
+    mean /= c->free_count + 1;
+    for (int i = 0; i <= c->free_count; i++) {
+        r[n++] = sqrt(CALIBRATION_SHAPE_PENALTY) * (shift[i] - mean);
+    }
+    return n;
+}
+
+static double sum_squares(const double* r, int n) {
+    double total = 0.0;
+    for (int i = 0; i < n; i++) total += r[i] * r[i];
+    return total;
+}
+
+/* Solves a x = b in place by Gaussian elimination with partial pivoting.
+   Returns 0 if the system is singular. */
+static int solve_linear(double a[CALIBRATION_PARAMS][CALIBRATION_PARAMS], double* b, int d) {
+    for (int col = 0; col < d; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < d; row++) {
+            if (fabs(a[row][col]) > fabs(a[pivot][col])) pivot = row;
+        }
+        if (fabs(a[pivot][col]) < 1e-300) return 0;
+        if (pivot != col) {
+            for (int k = 0; k < d; k++) {
+                double swap = a[col][k];
+                a[col][k] = a[pivot][k];
+                a[pivot][k] = swap;
+            }
+            double swap = b[col];
+            b[col] = b[pivot];
+            b[pivot] = swap;
+        }
+        for (int row = col + 1; row < d; row++) {
+            double f = a[row][col] / a[col][col];
+            for (int k = col; k < d; k++) a[row][k] -= f * a[col][k];
+            b[row] -= f * b[col];
+        }
+    }
+    for (int row = d - 1; row >= 0; row--) {
+        for (int k = row + 1; k < d; k++) b[row] -= a[row][k] * b[k];
+        b[row] /= a[row][row];
+    }
+    return 1;
+}
+
+/* Levenberg-Marquardt on a forward-difference Jacobian. The differences
+   are only usable because every candidate replays the same random
+   streams: with fresh draws the change from a small step would be lost in
+   the batch's own noise. */
+static double calibration_minimize(Calibration* c, double x[CALIBRATION_PARAMS], int d) {
+    double r[CALIBRATION_RESIDUALS], trial_r[CALIBRATION_RESIDUALS];
+    double jacobian[CALIBRATION_RESIDUALS][CALIBRATION_PARAMS];
+    double trial[CALIBRATION_PARAMS];
+    double damping = 1e-3;
+    int n = calibration_residuals(c, x, r);
+    double cost = sum_squares(r, n);
+    
+    while (c->evaluations + d + 1 <= CALIBRATION_MAX_EVALUATIONS) {
+        for (int j = 0; j < d; j++) {
+            memcpy(trial, x, d * sizeof(double));
+            trial[j] += CALIBRATION_STEP;
+            calibration_residuals(c, trial, trial_r);
+            for (int i = 0; i < n; i++) jacobian[i][j] = (trial_r[i] - r[i]) / CALIBRATION_STEP;
+        }
+        
+        double gradient[CALIBRATION_PARAMS];
+        double normal[CALIBRATION_PARAMS][CALIBRATION_PARAMS];
+        for (int j = 0; j < d; j++) {
+            gradient[j] = 0.0;
+            for (int i = 0; i < n; i++) gradient[j] += jacobian[i][j] * r[i];
+            for (int k = 0; k < d; k++) {
+                normal[j][k] = 0.0;
+                for (int i = 0; i < n; i++) normal[j][k] += jacobian[i][j] * jacobian[i][k];
+            }
+        }
+        
+        /* Raise the damping until a step lowers the cost. */
+        int improved = 0;
+        double step_size = 0.0;
+        while (!improved && damping < 1e6 && c->evaluations < CALIBRATION_MAX_EVALUATIONS) {
+            double a[CALIBRATION_PARAMS][CALIBRATION_PARAMS];
+            double step[CALIBRATION_PARAMS];
+            for (int j = 0; j < d; j++) {
+                for (int k = 0; k < d; k++) a[j][k] = normal[j][k];
+                a[j][j] += damping * (normal[j][j] + 1e-9);
+                step[j] = -gradient[j];
+            }
+            if (!solve_linear(a, step, d)) {
+                damping *= 4.0;
+                continue;
+            }
+            
+            step_size = 0.0;
+            for (int j = 0; j < d; j++) {
+                trial[j] = x[j] + step[j];
+                if (fabs(step[j]) > step_size) step_size = fabs(step[j]);
+            }
+            calibration_residuals(c, trial, trial_r);
+            double trial_cost = sum_squares(trial_r, n);
+            if (trial_cost < cost) {
+                improved = 1;
+                memcpy(x, trial, d * sizeof(double));
+                memcpy(r, trial_r, n * sizeof(double));
+                damping = damping / 3.0 > 1e-7 ? damping / 3.0 : 1e-7;
+                if (cost - trial_cost < CALIBRATION_MIN_GAIN * (1.0 + cost)) step_size = 0.0;
+                cost = trial_cost;
+            } else {
+                damping *= 4.0;
+            }
+        }
+        if (!improved || step_size < CALIBRATION_MIN_STEP) break;
+    }
+    return cost;
+}
+
+/* Fits the wicket probability and run weights to the targets, starting
+   from the current configuration, and prints the options that reproduce
+   the fit. The fitted values are checked once more on a fresh seed. */
+static int run_calibration(ThreadPool* pool, const MatchState* base, long matches,
+                           uint64_t seed, const double target[CALIBRATION_TARGETS]) {
+    Calibration* c = (Calibration*)malloc(sizeof(Calibration));
+    if (!c) {
+        fprintf(stderr, "NOT ENOUGH MEMORY FOR THE CALIBRATION\n");
+        return 1;
+    }
+    c->pool = pool;
+    c->base = *base;
+    c->matches = matches;
+    c->seed = seed;
+    c->evaluations = 0;
+    memcpy(c->target, target, sizeof(c->target));
+    memcpy(c->start_weights, base->config.run_weights, sizeof(c->start_weights));
+    
+    /* Runs with a zero weight stay impossible. */
+    int anchor = -1;
+    c->free_count = 0;
+    for (int r = 0; r < 7; r++) {
+        if (c->start_weights[r] <= 0.0f) continue;
+        if (anchor < 0) {
+            anchor = r;
+        } else {
+            c->free_runs[c->free_count++] = r;
+        }
+    }
+    
+    double x[CALIBRATION_PARAMS];
+    double p = base->config.wicket_probability;
+    if (p < 0.001) p = 0.001;
+    if (p > 0.999) p = 0.999;
+    x[0] = log(p / (1.0 - p));
+    for (int i = 0; i < c->free_count; i++) {
+        x[1 + i] = log(c->start_weights[c->free_runs[i]]);
+    }
+    
+    printf("CALIBRATING %d PARAMETERS ON %ld MATCHES PER CANDIDATE (SEED %llu)\n",
+           1 + c->free_count, matches, (unsigned long long)seed);
+    double start = now_seconds();
+    double cost = calibration_minimize(c, x, 1 + c->free_count);
+    double elapsed = now_seconds() - start;
+    
+    GameConfig fit;
+    double got[CALIBRATION_TARGETS], check[CALIBRATION_TARGETS];
+    calibration_config(c, x, &fit);
+    calibration_measure(c, &fit, seed, got);
+    calibration_measure(c, &fit, seed + 1, check);
+    
+    printf("%ld CANDIDATES IN %.2fs, COST %.6f\n", c->evaluations - 2, elapsed, cost);
+    printf("%-22s %10s %10s %10s\n", "TARGET", "WANTED", "FITTED", "NEW SEED");
+    for (int k = 0; k < CALIBRATION_TARGETS; k++) {
+        if (target[k] < 0) {
+            printf("%-22s %10s %10.3f %10.3f\n", calibration_names[k], "-", got[k], check[k]);
+        } else {
+            printf("%-22s %10.3f %10.3f %10.3f\n", calibration_names[k], target[k], got[k], check[k]);
+        }
+    }
+    
+    /* Weights are printed scaled to an average of 1. */
+    double total = 0.0;
+    for (int r = 0; r < 7; r++) total += fit.run_weights[r];
+    printf("WICKET PROBABILITY: %.6f\n", fit.wicket_probability);
+    printf("RUN WEIGHTS:");
+    for (int r = 0; r < 7; r++) printf("  %d: %.4f", r, 7.0 * fit.run_weights[r] / total);
+    printf("\nOPTIONS: --wicket-prob %.6f --run-weights ", fit.wicket_probability);
+    for (int r = 0; r < 7; r++) printf("%s%.4f", r ? "," : "", 7.0 * fit.run_weights[r] / total);
+    printf("\n");
+    
+    free(c);
+    return 0;
+}
+
+static int lineup_has(const int* chosen, int n, int player) {
+    for (int i = 0; i < n; i++) {
+        if (chosen[i] == player) return 1;
+    }
+    return 0;
+}
+
+/* Orders the chosen players by key, highest first, into a lineup. */
+static void lineup_fill(Lineup* l, int* chosen, int* key, const int* bowls, int size) {
+    int order[MAX_PLAYERS];
+    
+    for (int i = 0; i < size; i++) {
+        int j = i;
+        while (j > 0 && key[order[j - 1]] < key[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    memset(l, 0, sizeof(*l));
+    for (int i = 0; i < size; i++) {
+        l->pick[i] = (uint16_t)chosen[order[i]];
+        if (bowls[order[i]]) l->bowlers |= (uint16_t)(1u << i);
+    }
+}
+
+/* A random lineup leaning towards strong players: 2-5 bowlers chosen by
+   bowling rating and the rest by batting rating, each the best of three
+   draws, then ordered by batting rating with some noise. */
+static void lineup_random(const Player* pool, int pool_size, const int* bowlers, int bowler_count,
+                          int size, Rng* rng, Lineup* l) {
+    int chosen[MAX_PLAYERS], key[MAX_PLAYERS], bowls[MAX_PLAYERS];
+    int most = bowler_count < 5 ? bowler_count : 5;
+    if (most > size) most = size;
+    int k = 2 + (int)rng_below(rng, (uint32_t)(rng_next(rng) >> 32), (uint32_t)(most - 1));
+    
+    for (int n = 0; n < size; n++) {
+        int best = -1;
+        for (int draw = 0; draw < 3; draw++) {
+            int p;
+            do {
+                p = n < k ? bowlers[rng_below(rng, (uint32_t)(rng_next(rng) >> 32), (uint32_t)bowler_count)]
+                          : (int)rng_below(rng, (uint32_t)(rng_next(rng) >> 32), (uint32_t)pool_size);
+            } while (lineup_has(chosen, n, p));
+            if (best < 0 || (n < k ? pool[p].bowling > pool[best].bowling
+                                   : pool[p].batting > pool[best].batting)) {
+                best = p;
+            }
+        }
+        chosen[n] = best;
+        bowls[n] = n < k;
+        key[n] = pool[best].batting + (int)rng_below(rng, (uint32_t)(rng_next(rng) >> 32), 31) - 15;
+    }
+    lineup_fill(l, chosen, key, bowls, size);
+}
+
+/* The obvious picks: the k best bowlers, the best batsmen for the other
+   places, in batting order. */
+static void lineup_greedy(const Player* pool, const int* by_batting, int pool_size,
+                          const int* by_bowling, int k, int size, Lineup* l) {
+    int chosen[MAX_PLAYERS], key[MAX_PLAYERS], bowls[MAX_PLAYERS];
+    int n = 0;
+    
+    for (; n < k; n++) {
+        chosen[n] = by_bowling[n];
+        bowls[n] = 1;
+        key[n] = pool[chosen[n]].batting;
+    }
+    for (int i = 0; i < pool_size && n < size; i++) {
+        if (lineup_has(chosen, n, by_batting[i])) continue;
+        chosen[n] = by_batting[i];
+        bowls[n] = 0;
+        key[n] = pool[chosen[n]].batting;
+        n++;
+    }
+    lineup_fill(l, chosen, key, bowls, size);
+}
+
+/* Only the players are copied; names are looked up in the pool's table
+   when a lineup is printed. */
+static void lineup_team(const Player* pool, int size, const Lineup* l, Team* team) {
+    for (int i = 0; i < size; i++) {
+        team->players[i] = pool[l->pick[i]];
+        team->players[i].is_bowler = (l->bowlers >> i) & 1;
+    }
+    team->player_count = size;
+}
+
+static uint64_t lineup_hash(const Lineup* l, int size) {
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ l->bowlers;
+    
+    for (int i = 0; i < size; i++) {
+        h = (h ^ l->pick[i]) * 0x100000001B3ULL;
+    }
+    return h ^ (h >> 29);
+}
+
+static double lineup_score(const Lineup* l) {
+    return l->played > 0 ? (l->wins + 0.5 * l->ties) / l->played : 0.0;
+}
+
+static int compare_lineups(const void* a, const void* b) {
+    double x = lineup_score((const Lineup*)a);
+    double y = lineup_score((const Lineup*)b);
+    
+    if (x != y) return x < y ? 1 : -1;
+    return 0;
+}
+
+static const Player* rating_pool;
+
+static int compare_by_batting(const void* a, const void* b) {
+    return rating_pool[*(const int*)b].batting - rating_pool[*(const int*)a].batting;
+}
+
+static int compare_by_bowling(const void* a, const void* b) {
+    return rating_pool[*(const int*)b].bowling - rating_pool[*(const int*)a].bowling;
+}
+
+/* Up to `wanted` distinct lineups: the greedy ones first, then random. */
+static int selection_candidates(const Player* pool, int pool_size, int size, int wanted,
+                                uint64_t seed, Lineup* lineups) {
+    int* by_batting = (int*)malloc(pool_size * sizeof(int));
+    int* by_bowling = (int*)malloc(pool_size * sizeof(int));
+    size_t slots = 16;
+    while (slots < (size_t)wanted * 2) slots *= 2;
+    uint64_t* seen = (uint64_t*)calloc(slots, sizeof(uint64_t));
+    int count = 0, bowler_count = 0;
+    
+    if (!by_batting || !by_bowling || !seen) {
+        free(by_batting);
+        free(by_bowling);
+        free(seen);
+        return 0;
+    }
+    for (int i = 0; i < pool_size; i++) {
+        by_batting[i] = i;
+        if (pool[i].is_bowler) by_bowling[bowler_count++] = i;
+    }
+    rating_pool = pool;
+    qsort(by_batting, pool_size, sizeof(int), compare_by_batting);
+    qsort(by_bowling, bowler_count, sizeof(int), compare_by_bowling);
+    
+    Rng rng;
+    rng_stream(&rng, seed, UINT64_MAX);
+    long attempts = 0;
+    for (int k = 2; count < wanted && attempts < 20L * wanted; attempts++) {
+        Lineup* l = &lineups[count];
+        if (k <= 5 && k <= bowler_count && k <= size) {
+            lineup_greedy(pool, by_batting, pool_size, by_bowling, k++, size, l);
+        } else {
+            lineup_random(pool, pool_size, by_bowling, bowler_count, size, &rng, l);
+        }
+        
+        /* Zero marks an empty slot, so a zero hash is nudged. */
+        uint64_t h = lineup_hash(l, size) | 1;
+        size_t slot = (size_t)h & (slots - 1);
+        while (seen[slot] && seen[slot] != h) slot = (slot + 1) & (slots - 1);
+        if (seen[slot]) continue;
+        seen[slot] = h;
+        count++;
+    }
+    
+    free(by_batting);
+    free(by_bowling);
+    free(seen);
+    return count;
+}
+
+static void selection_task(void* ctx, int worker, long begin, long end) {
+    SelectionJob* job = (SelectionJob*)ctx;
+    MatchState* m = &job->states[worker];
+    long count = job->matches / job->chunks;
+    
+    for (long item = begin; item < end; item++) {
+        const Lineup* l = &job->lineups[item / job->chunks];
+        long part = item % job->chunks;
+        /* The last chunk also plays the remainder, so every lineup plays
+           exactly job->matches. */
+        long n = part == job->chunks - 1 ? job->matches - part * count : count;
+        BatchStats stats;
+        
+        memset(&stats, 0, sizeof(stats));
+        lineup_team(job->pool, job->size, l, &m->teams[0]);
+        match_prepare(m);
+        run_batch(m, job->first + part * count, n, job->seed, &stats, NULL);
+        job->results[item] = stats;
+    }
+}
+
+/* Plays every live lineup's next `matches` matches against the opponent.
+   All lineups play the same match indices, so they face the same random
+   streams and are compared on equal luck. */
+static int selection_round(ThreadPool* pool, SelectionJob* job, Lineup* lineups, int alive,
+                           long matches) {
+    long chunks = 1;
+    while (chunks * 2 <= matches / 64 && alive * chunks < 8L * pool->thread_count) chunks *= 2;
+    
+    job->lineups = lineups;
+    job->first = lineups[0].played;
+    job->matches = matches;
+    job->chunks = chunks;
+    job->results = (BatchStats*)malloc(alive * chunks * sizeof(BatchStats));
+    if (!job->results) return 0;
+    
+    pool_run(pool, selection_task, job, alive * chunks, 1);
+    
+    for (long item = 0; item < alive * chunks; item++) {
+        Lineup* l = &lineups[item / chunks];
+        l->played += job->results[item].matches;
+        l->wins += job->results[item].wins[0];
+        l->ties += job->results[item].ties;
+    }
+    free(job->results);
+    job->results = NULL;
+    return 1;
+}
+
+/* Successive halving: every live lineup plays a round, the better half
+   survives, and the next round is twice as long, so the budget goes to the
+   lineups that are hard to tell apart. The finalists' exact win chances
+   from the win-probability table are printed alongside. */
+int run_best_xi(const char* pool_path, const Team* opponent, int wanted, long first_round,
+                uint64_t seed, int threads, const char* xi_path) {
+    char pool_name[MAX_NAME_LENGTH];
+    Player* players;
+    PlayerName* names;
+    int pool_size = load_player_pool(pool_path, pool_name, &players, &names);
+    if (pool_size < 0) {
+        fprintf(stderr, "CANNOT READ PLAYER POOL: %s\n", pool_path);
+        return 1;
+    }
+    int bowler_count = 0;
+    for (int i = 0; i < pool_size; i++) bowler_count += players[i].is_bowler;
+    if (pool_size < 2 || bowler_count < 2) {
+        fprintf(stderr, "THE POOL NEEDS AT LEAST 2 PLAYERS AND 2 BOWLERS\n");
+        free(players);
+        free(names);
+        return 1;
+    }
+    int size = pool_size < MAX_PLAYERS ? pool_size : MAX_PLAYERS;
+    
+    Lineup* lineups = (Lineup*)malloc(wanted * sizeof(Lineup));
+    ThreadPool* pool = pool_create(threads);
+    if (!lineups || !pool) {
+        fprintf(stderr, "CANNOT START THE SELECTION\n");
+        free(lineups);
+        free(players);
+        free(names);
+        if (pool) pool_destroy(pool);
+        return 1;
+    }
+    int alive = selection_candidates(players, pool_size, size, wanted, seed, lineups);
+    
+    Team squads[MAX_TEAMS];
+    memset(&squads[0], 0, sizeof(Team));
+    copy_name(squads[0].name, pool_name);
+    lineup_team(players, size, &lineups[0], &squads[0]);
+    squads[1] = *opponent;
+    
+    SelectionJob job;
+    memset(&job, 0, sizeof(job));
+    job.pool = players;
+    job.size = size;
+    job.seed = seed;
+    job.states = (MatchState*)malloc(pool->thread_count * sizeof(MatchState));
+    if (!job.states) {
+        fprintf(stderr, "CANNOT START THE SELECTION\n");
+        pool_destroy(pool);
+        free(lineups);
+        free(players);
+        free(names);
+        return 1;
+    }
+    match_init(&job.states[0], squads, &config);
+    for (int w = 1; w < pool->thread_count; w++) job.states[w] = job.states[0];
+    
+    printf("POOL: %s (%d PLAYERS, %d BOWLERS)  OPPONENT: %s  LINEUPS: %d\n",
+           pool_name, pool_size, bowler_count, opponent->name, alive);
+    printf("%5s %8s %10s %12s %10s\n", "ROUND", "LINEUPS", "MATCHES", "TOTAL", "BEST WIN%");
+    
+    double start = now_seconds();
+    long total = 0;
+    long matches = first_round;
+    for (int round = 1; ; round++) {
+        if (!selection_round(pool, &job, lineups, alive, matches)) {
+            fprintf(stderr, "NOT ENOUGH MEMORY FOR THE SELECTION\n");
+            break;
+        }
+        total += alive * matches;
+        qsort(lineups, alive, sizeof(Lineup), compare_lineups);
+        printf("%5d %8d %10ld %12ld %9.2f%%\n",
+               round, alive, lineups[0].played, total, 100.0 * lineup_score(&lineups[0]));
+        if (alive <= SELECTION_FINALISTS) break;
+        alive = (alive + 1) / 2;
+        if (alive < SELECTION_FINALISTS) alive = SELECTION_FINALISTS;
+        matches *= 2;
+    }
+    double elapsed = now_seconds() - start;
+    
+    printf("%ld MATCHES IN %.2fs (%.0f MATCHES/SEC)\n\n", total, elapsed,
+           elapsed > 0 ? total / elapsed : 0.0);
+    printf("%4s %8s %8s %10s %10s  %s\n", "RANK", "WIN%", "TIE%", "EXACT WIN%", "BOWLERS", "ORDER");
+    
+    MatchState* probe = &job.states[0];
+    for (int i = 0; i < alive; i++) {
+        const Lineup* l = &lineups[i];
+        lineup_team(players, size, l, &probe->teams[0]);
+        match_prepare(probe);
+        
+        double exact = -1.0;
+        WinProbTable* t = winprob_build(probe);
+        if (t) {
+            WinTie first[MAX_TEAMS];
+            for (int team = 0; team < MAX_TEAMS; team++) {
+                first[team] = first_value(t, team, t->max_balls, t->all_out[team], 0);
+            }
+            exact = 0.5 * (first[0].win + 1.0 - first[1].win - first[1].tie);
+            winprob_free(t);
+        }
+        
+        printf("%4d %7.2f%% %7.2f%% %9.2f%% %10d  ", i + 1, 100.0 * l->wins / l->played,
+               100.0 * l->ties / l->played, 100.0 * exact, count_bowlers(&probe->teams[0]));
+        for (int p = 0; p < size && p < 4; p++) {
+            printf("%s%s", p ? ", " : "", names[l->pick[p]]);
+        }
+        printf("%s\n", size > 4 ? ", ..." : "");
+    }
+    
+    /* The winner in roster format, ready for --team1. */
+    lineup_team(players, size, &lineups[0], &squads[0]);
+    FILE* out = xi_path ? fopen(xi_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "CANNOT WRITE %s\n", xi_path);
+    } else {
+        if (!xi_path) printf("\nBEST XI:\n");
+        fprintf(out, "%s\n", squads[0].name);
+        for (int i = 0; i < size; i++) {
+            const Player* p = &squads[0].players[i];
+            fprintf(out, "%s%s bat=%d bowl=%d\n", names[lineups[0].pick[i]], p->is_bowler ? " *" : "",
+                    p->batting, p->bowling);
+        }
+        if (xi_path) {
+            fclose(out);
+            printf("\nBEST XI WRITTEN TO %s\n", xi_path);
+        }
+    }
+    
+    free(job.states);
+    pool_destroy(pool);
+    free(lineups);
+    free(players);
+    free(names);
+    return out ? 0 : 1;
+}
+
+/* Sets up the sides and format from the command line and hands over to
+   run_tournament(). Without --rosters every side is a generated XI. */
+static int run_tournament_command(const char* format, const char* roster_list, int side_count,
+                                  int groups, int qualify, long runs, uint64_t seed, int threads) {
+    if (strcmp(format, "league") == 0) {
+        groups = 1;
+        if (qualify < 0) qualify = 4;
+    } else if (strcmp(format, "groups") == 0) {
+        if (qualify < 0) qualify = 2;
+    } else {
+        fprintf(stderr, "UNKNOWN TOURNAMENT FORMAT: %s (league or groups)\n", format);
+        return 1;
+    }
+    if (runs < 1 || threads < 1 || config.max_overs <= 0 ||
+        config.wicket_probability < 0.0f || config.wicket_probability > 1.0f) {
+        fprintf(stderr, "RUNS, THREADS AND OVERS MUST BE POSITIVE AND THE WICKET PROBABILITY IN [0, 1]\n");
+        return 1;
+    }
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    
+    Team* sides = (Team*)calloc(MAX_SIDES, sizeof(Team));
+    if (!sides) {
+        fprintf(stderr, "NOT ENOUGH MEMORY FOR THE TOURNAMENT\n");
+        return 1;
+    }
+    if (roster_list) {
+        side_count = load_roster_list(roster_list, sides, MAX_SIDES);
+        if (side_count < 0) {
+            fprintf(stderr, "CANNOT READ ROSTER LIST: %s\n", roster_list);
+            free(sides);
+            return 1;
+        }
+    } else {
+        for (int i = 0; i < side_count && i < MAX_SIDES; i++) {
+            char name[MAX_NAME_LENGTH];
+            snprintf(name, sizeof(name), "SIDE %d", i + 1);
+            default_roster(&sides[i], name);
+        }
+    }
+    for (int i = 0; i < side_count && i < MAX_SIDES; i++) {
+        if (sides[i].player_count < 2 || count_bowlers(&sides[i]) < 2) {
+            fprintf(stderr, "%s NEEDS AT LEAST 2 PLAYERS AND 2 BOWLERS\n", sides[i].name);
+            free(sides);
+            return 1;
+        }
+    }
+    
+    Tournament t;
+    if (!tournament_init(&t, sides, side_count, groups, qualify, &config,
+                         outcome_model_for(&config), seed)) {
+        free(sides);
+        return 1;
+    }
+    int status = run_tournament(&t, runs, threads);
+    tournament_free(&t);
+    free(sides);
+    return status;
+}
+
+/* Plays each match of the batch up to pause_at balls and stores it in
+   its record of the save file, exactly as run_batch() would have got it
+   there. */
+static void checkpoint_task(void* ctx, int worker, long begin, long end) {
+    CheckpointJob* job = (CheckpointJob*)ctx;
+    MatchState* m = &job->states[worker];
+    BallResult result;
+    
+    for (long n = begin; n < end; n++) {
+        reset_match_state(m);
+        rng_stream(&m->rng, job->seed, (uint64_t)n);
+        m->currently_batting = (int)(rng_next(&m->rng) >> 63);
+        for (int ball = 0; ball < job->pause_at && !m->match_over; ball++) {
+            if (play_ball(m, &result) <= 0) break;
+        }
+        match_to_saved(m, &job->saved[n]);
+    }
+}
+
+/* Finishes saved matches straight from the mapping. The balls bowled
+   before the pause are counted from the scorecards. */
+static void resume_task(void* ctx, int worker, long begin, long end) {
+    CheckpointJob* job = (CheckpointJob*)ctx;
+    MatchState* m = &job->states[worker];
+    BatchStats* stats = &job->results[worker].stats;
+    BallResult result;
+    
+    for (long n = begin; n < end; n++) {
+        match_from_saved(&job->saved[n], m);
+        int batting_first = m->first_innings ? m->currently_batting : 1 - m->currently_batting;
+        while (!m->match_over && play_ball(m, &result) > 0) {
+        }
+        
+        for (int t = 0; t < MAX_TEAMS; t++) {
+            stats->balls += m->teams[t].total_balls;
+            for (int i = 0; i < m->teams[t].player_count; i++) {
+                stats->boundaries += m->teams[t].players[i].fours + m->teams[t].players[i].sixes;
+            }
+        }
+        tally_match(stats, m, batting_first);
+    }
+}
+
+/* --checkpoint: pauses every match of a batch after pause_at balls and
+   writes them all to one save file. */
+static int run_checkpoint(ThreadPool* pool, const MatchState* base, long matches, uint64_t seed,
+                          int pause_at, const char* path) {
+    char tmp_path[FILENAME_MAX];
+    uint32_t counts[SAVE_SECTIONS] = {0, (uint32_t)matches, 0};
+    SaveImage img;
+    CheckpointJob job;
+    uint32_t n;
+    
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    job.states = (MatchState*)malloc(pool->thread_count * sizeof(MatchState));
+    if (!job.states || !save_create(&img, tmp_path, counts)) {
+        fprintf(stderr, "CANNOT CREATE CHECKPOINT: %s\n", path);
+        free(job.states);
+        return 1;
+    }
+    for (int w = 0; w < pool->thread_count; w++) {
+        job.states[w] = *base;
+    }
+    job.base = base;
+    job.saved = (SavedMatch*)save_section(&img, SAVE_MATCHES, &n);
+    job.seed = seed;
+    job.pause_at = pause_at;
+    
+    double start = now_seconds();
+    pool_run(pool, checkpoint_task, &job, matches, 256);
+    STATS_START(save_start);
+    int ok = save_commit(&img, tmp_path, path);
+    STATS_STOP(PHASE_SAVE, save_start);
+    double elapsed = now_seconds() - start;
+    free(job.states);
+    
+    if (!ok) {
+        fprintf(stderr, "CANNOT WRITE CHECKPOINT: %s\n", path);
+        return 1;
+    }
+    printf("PAUSED %ld MATCHES AFTER %d BALLS IN %s (%.1f MB, %.3fs)\n",
+           matches, pause_at, path, (double)matches * sizeof(SavedMatch) / 1e6, elapsed);
+    return 0;
+}
+
+/* --resume: maps a checkpoint and plays every match in it to the end. */
+static int run_resume(ThreadPool* pool, const char* path) {
+    SaveImage img;
+    CheckpointJob job;
+    BatchStats stats;
+    uint32_t matches;
+    
+    double start = now_seconds();
+    STATS_START(load_start);
+    int opened_ok = save_open(&img, path) > 0;
+    STATS_STOP(PHASE_LOAD, load_start);
+    if (!opened_ok) {
+        fprintf(stderr, "CANNOT LOAD CHECKPOINT: %s\n", path);
+        return 1;
+    }
+    job.saved = (SavedMatch*)save_section(&img, SAVE_MATCHES, &matches);
+    double opened = now_seconds();
+    if (matches == 0) {
+        fprintf(stderr, "NO PAUSED MATCHES IN %s\n", path);
+        save_close(&img);
+        return 1;
+    }
+    
+    /* The model cache is not locked, so every model the workers need is
+       built here first. */
+    for (uint32_t i = 0; i < matches; i++) {
+        GameConfig cfg = config;
+        cfg.wicket_probability = job.saved[i].wicket_probability;
+        memcpy(cfg.run_weights, job.saved[i].run_weights, sizeof(cfg.run_weights));
+        outcome_model_for(&cfg);
+    }
+    
+    job.states = (MatchState*)malloc(pool->thread_count * sizeof(MatchState));
+    job.results = (WorkerStats*)calloc(pool->thread_count, sizeof(WorkerStats));
+    if (!job.states || !job.results) {
+        free(job.states);
+        free(job.results);
+        save_close(&img);
+        return 1;
+    }
+    pool_run(pool, resume_task, &job, matches, 256);
+    double elapsed = now_seconds() - opened;
+    
+    memset(&stats, 0, sizeof(stats));
+    for (int w = 0; w < pool->thread_count; w++) {
+        merge_batch_stats(&stats, &job.results[w].stats);
+    }
+    match_from_saved(&job.saved[0], &match);
+    print_batch_stats(&match, &stats);
+    printf("MAPPED AND VERIFIED %u PAUSED MATCHES IN %.1f ms, FINISHED THEM IN %.3fs  BALLS: %lld\n",
+           matches, (opened - start) * 1e3, elapsed, stats.balls);
+    
+    free(job.states);
+    free(job.results);
+    save_close(&img);
+    return 0;
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr,
+            "USAGE: %s [--seed N] [--batch N] [OPTIONS]\n"
+            "  --seed N              seed for the random generator (default: time)\n"
+            "  --batch N             simulate N matches without terminal I/O\n"
+            "  --team1 FILE          roster for team 1 (default: generated XI)\n"
+            "  --team2 FILE          roster for team 2 (default: generated XI)\n"
+            "  --overs N             overs per innings (default %d)\n"
+            "  --wicket-prob P       wicket probability per ball (default %.2f)\n"
+            "  --threads N           worker threads (default: all %d cores)\n"
+            "  --scaling             time the batch on 1, 2, 4 ... N threads\n"
+            "  --kernel K            scalar (play_ball, the default) or lockstep (16 matches\n"
+            "                        a step, only fast with -march=native)\n"
+            "  --run-weights W       seven comma-separated weights for 0-6 runs off a\n"
+            "                        non-wicket ball (default: all equal)\n"
+            "  --winprob-check       compare the exact win probability table with the batch\n",
+            prog, DEFAULT_OVERS, config.wicket_probability, cpu_count());
+    fprintf(stderr,
+            "  --calibrate           fit --wicket-prob and --run-weights to the targets below,\n"
+            "                        playing --batch matches per candidate (default %d)\n"
+            "  --target-score X      average first-innings score\n"
+            "  --target-wickets X    average wickets per innings\n"
+            "  --target-boundaries X percentage of balls hit for 4 or 6\n"
+            "  --target-ties X       percentage of matches tied\n"
+            "  --best-xi POOL        pick the lineup from a roster-format pool of players\n"
+            "                        that wins most often against --team2\n"
+            "  --candidates N        lineups tried by --best-xi (default %d)\n"
+            "  --xi-file FILE        write the chosen lineup as a roster file\n",
+            CALIBRATION_MATCHES, SELECTION_CANDIDATES);
+    fputs("  --log BASE            append every ball to BASE.bin/.idx/.rosters (scalar kernel)\n"
+          "  --sync-every N        fsync the match history or --log every N matches\n"
+          "  --sync-ms T           fsync it at most T ms after a write (default: leave\n"
+          "                        it to the OS)\n"
+          "  --scan BASE           verify an event log and print its totals\n"
+          "  --query Q             wins, scores, top-scorers or top-wickets over the\n"
+          "                        match history (or the --log BASE of a batch)\n"
+          "  --team NAME           limit --query to one team\n"
+          "  --top N               rows shown by top-scorers/top-wickets (default 10)\n"
+          "  --replay N            step through match N of the match history (or --log\n"
+          "                        BASE); with --seed and no --log, match N of a --batch\n"
+          "                        run with that seed and options on the scalar kernel\n"
+          "  --ball N              with --replay, print the board after ball N and exit\n"
+          "  --checkpoint FILE     with --batch, pause every match after --pause-at balls\n"
+          "                        and save them all to FILE\n"
+          "  --pause-at N          balls bowled before a --checkpoint (default 60)\n"
+          "  --resume FILE         finish every match saved by --checkpoint\n", stderr);
+    fprintf(stderr,
+            "  --tournament F        play a league or groups tournament (see --sides)\n"
+            "  --sides N             generated sides in the tournament (default 32)\n"
+            "  --rosters FILE        file listing one roster file per tournament side\n"
+            "  --groups N            groups in a groups tournament (default 4)\n"
+            "  --qualify N           sides per group into the knockout (league 4, groups 2;\n"
+            "                        0 plays a league with no knockout)\n"
+            "  --runs N              simulate the tournament N times and print each\n"
+            "                        side's chance of qualifying and winning\n"
+            "  --ci W                with --batch, play in rounds until team 1's win\n"
+            "                        probability is known to within +-W points (95%%);\n"
+            "                        --batch is then the limit (default %d)\n"
+            "  --antithetic          pair every match with one on mirrored draws\n"
+            "  --compare FILE        estimate the change from playing FILE as team 1,\n"
+            "                        both on the same random streams\n"
+            "  --compare-wicket-prob P, --compare-run-weights W\n"
+            "                        estimate the change from this model instead (or too)\n",
+            ESTIMATE_MAX_MATCHES);
+    fputs("  --stats F             print engine counters and timings as text or json on\n"
+          "                        stderr at exit (SIGUSR1 prints them at any time)\n"
+          "  --serve PATH          answer simulate, winprob and tournament requests on\n"
+          "                        the Unix socket PATH (see the user guide)\n"
+          "Without --batch the interactive game starts (seeded by --seed).\n", stderr);
+}
+
+/* Reads "w0,w1,...,w6"; every weight must be non-negative and at least
+   one positive. */
+static int parse_run_weights(const char* text, float weights[7]) {
+    float total = 0.0f;
+    
+    for (int r = 0; r < 7; r++) {
+        char* end;
+        double w = strtod(text, &end);
+        if (end == text || w < 0.0 || *end != (r < 6 ? ',' : '\0')) return 0;
+        weights[r] = (float)w;
+        total += weights[r];
+        text = end + 1;
+    }
+    return total > 0.0f;
+}
+
+#ifndef _WIN32
+static void serve_signal(int sig) {
+    (void)sig;
+    serve_stop = 1;
+}
+
+/* Plays the pool's share of one round. A chunk may straddle two requests,
+   so it is split at the segment boundaries; match n of a request is
+   always stream n of its seed, exactly as in --batch. */
+static void serve_task(void* ctx, int worker, long begin, long end) {
+    ServeJob* job = (ServeJob*)ctx;
+    
+    for (int i = 0; i < job->segment_count && begin < end; i++) {
+        ServeSegment* seg = &job->segments[i];
+        if (begin >= seg->offset + seg->count) continue;
+        
+        ServeRequest* r = seg->request;
+        long stop = end < seg->offset + seg->count ? end : seg->offset + seg->count;
+        long first = r->done + (begin - seg->offset);
+        BatchStats part;
+        
+        memset(&part, 0, sizeof(part));
+        STATS_START(start);
+        if (r->kernel == KERNEL_LOCKSTEP) {
+            run_lockstep_batch(&r->base, first, stop - begin, r->seed, &part);
+        } else {
+            job->states[worker] = r->base;
+            run_batch(&job->states[worker], first, stop - begin, r->seed, &part, NULL);
+        }
+        STATS_CHUNK(&part, r->kernel == KERNEL_SCALAR, start);
+        
+        mutex_lock(&job->lock);
+        merge_batch_stats(&r->stats, &part);
+        mutex_unlock(&job->lock);
+        begin = stop;
+    }
+}
+
+/* Sends one reply line. A client that cannot take it is marked failed and
+   dropped by the main loop. */
+static void serve_send(ServeClient* c, const char* format, ...) {
+    char line[512];
+    va_list args;
+    
+    if (c->failed) return;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (len < 0) return;
+    if (len > (int)sizeof(line) - 2) len = (int)sizeof(line) - 2;
+    line[len++] = '\n';
+    
+    const char* p = line;
+    while (len > 0) {
+        ssize_t n = write(c->fd, p, (size_t)len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            c->failed = 1;
+            return;
+        }
+        p += n;
+        len -= (int)n;
+    }
+}
+
+/* Every simulation and tournament builds its own outcome model, so a
+   client sending new wicket-prob or run-weights values cannot grow the
+   cache behind outcome_model_for(). winprob requests share one model and
+   one table, rebuilt when a request changes either. */
+static OutcomeModel* serve_model = NULL;
+static WinProbTable* serve_table = NULL;
+
+static const OutcomeModel* serve_winprob_model(const GameConfig* cfg) {
+    uint64_t wicket_threshold = (uint64_t)(cfg->wicket_probability * 4294967296.0);
+    
+    if (serve_model && serve_model->wicket_threshold == wicket_threshold &&
+        memcmp(serve_model->run_weights, cfg->run_weights, sizeof(serve_model->run_weights)) == 0) {
+        return serve_model;
+    }
+    /* The table points at the model being rebuilt. */
+    winprob_free(serve_table);
+    serve_table = NULL;
+    if (!serve_model) serve_model = (OutcomeModel*)malloc(sizeof(OutcomeModel));
+    if (serve_model) outcome_model_build(serve_model, cfg);
+    return serve_model;
+}
+
+static const WinProbTable* serve_winprob_table(const MatchState* m) {
+    if (serve_table && winprob_matches(serve_table, m)) return serve_table;
+    
+    winprob_free(serve_table);
+    serve_table = winprob_build(m);
+    return serve_table;
+}
+
+static void serve_request_free(ServeRequest* r, int workers) {
+    if (r->kind == SERVE_TOURNAMENT) {
+        if (r->works) tournament_work_free(r->works, workers);
+        tournament_free(&r->tournament);
+    }
+    free(r->sides);
+    free(r);
+}
+
+static int serve_long(const char* text, long low, long high, long* out) {
+    char* end;
+    
+    errno = 0;
+    long v = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0 || v < low || v > high) return 0;
+    *out = v;
+    return 1;
+}
+
+/* Reads the roster sections after a request's header: "[team1] NAME",
+   "[team2] NAME" or "[side] NAME", each followed by player lines in
+   roster file syntax. Returns an error message, or NULL. */
+static const char* serve_rosters(char* text, Team* squads, Team* sides, int* side_count) {
+    Team* team = NULL;
+    
+    for (char* line = text; line != NULL; ) {
+        char* next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        
+        char* start = line;
+        while (*start == ' ' || *start == '\t') start++;
+        char* end = start + strlen(start);
+        while (end > start && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) *--end = '\0';
+        line = next;
+        if (*start == '\0' || *start == '#') continue;
+        
+        if (*start == '[') {
+            char* name = strchr(start, ']');
+            if (!name) return "BAD SECTION HEADER";
+            *name++ = '\0';
+            while (*name == ' ' || *name == '\t') name++;
+            
+            if (strcmp(start + 1, "team1") == 0 || strcmp(start + 1, "team2") == 0) {
+                if (!squads) return "THIS REQUEST TAKES [side] SECTIONS";
+                team = &squads[start[5] - '1'];
+            } else if (strcmp(start + 1, "side") == 0) {
+                if (!sides) return "THIS REQUEST TAKES [team1] AND [team2] SECTIONS";
+                if (*side_count >= MAX_SIDES) return "TOO MANY SIDES";
+                team = &sides[(*side_count)++];
+            } else {
+                return "UNKNOWN SECTION";
+            }
+            if (*name == '\0') return "A SECTION NEEDS A TEAM NAME";
+            memset(team, 0, sizeof(*team));
+            copy_name(team->name, name);
+            continue;
+        }
+        if (!team) return "PLAYER OUTSIDE A SECTION";
+        if (team->player_count >= MAX_PLAYERS) return "TOO MANY PLAYERS";
+        parse_player(start, end, &team->players[team->player_count],
+                     team->player_names[team->player_count]);
+        team->player_count++;
+    }
+    return NULL;
+}
+
+static const char* serve_check_sides(const Team* sides, int count) {
+    for (int i = 0; i < count; i++) {
+        if (sides[i].player_count < 2 || count_bowlers(&sides[i]) < 2) {
+            return "EVERY SIDE NEEDS AT LEAST 2 PLAYERS AND 2 BOWLERS";
+        }
+    }
+    return NULL;
+}
+
+/* Handles one complete request. Simulations and tournaments are queued
+   for the rounds; pings and win probabilities are answered at once. */
+static void serve_request(ServeClient* c, char* text, ServeRequest** queue, int* queued,
+                          ThreadPool* pool, uint64_t seed, BatchKernel kernel) {
+    char id[32] = "-";
+    const char* error = NULL;
+    GameConfig cfg = config;
+    long matches = 0, tournaments = 100;
+    long bat = 1, innings = 1, runs = 0, wickets = 0, balls = 0, target = 0;
+    long side_count = 32, groups = 4, qualify = -1;
+    const char* format = NULL;
+    
+    char* body = strchr(text, '\n');
+    if (body) *body++ = '\0';
+    
+    char* verb = strtok(text, " \t\r");
+    for (char* key = strtok(NULL, " \t\r"); key != NULL; key = strtok(NULL, " \t\r")) {
+        char* value = strchr(key, '=');
+        const char* bad = NULL;
+        long n;
+        
+        if (!value) {
+            if (!error) error = "EXPECTED KEY=VALUE";
+            continue;
+        }
+        *value++ = '\0';
+        
+        if (strcmp(key, "id") == 0) {
+            snprintf(id, sizeof(id), "%s", value);
+        } else if (strcmp(key, "overs") == 0) {
+            if (serve_long(value, 1, SERVE_MAX_OVERS, &n)) {
+                cfg.max_overs = (int)n;
+            } else {
+                bad = "OVERS MUST BE 1 TO 50";
+            }
+        } else if (strcmp(key, "wicket-prob") == 0) {
+            char* end;
+            double p = strtod(value, &end);
+            if (end == value || *end != '\0' || p < 0.0 || p > 1.0) {
+                bad = "WICKET PROBABILITY MUST BE IN [0, 1]";
+            } else {
+                cfg.wicket_probability = (float)p;
+            }
+        } else if (strcmp(key, "run-weights") == 0) {
+            if (!parse_run_weights(value, cfg.run_weights)) {
+                bad = "RUN WEIGHTS MUST BE 7 NON-NEGATIVE NUMBERS, NOT ALL ZERO";
+            }
+        } else if (strcmp(key, "seed") == 0) {
+            char* end;
+            seed = strtoull(value, &end, 10);
+            if (end == value || *end != '\0') bad = "BAD SEED";
+        } else if (strcmp(key, "kernel") == 0) {
+            if (strcmp(value, "scalar") == 0) {
+                kernel = KERNEL_SCALAR;
+            } else if (strcmp(value, "lockstep") == 0) {
+                kernel = KERNEL_LOCKSTEP;
+            } else {
+                bad = "UNKNOWN KERNEL";
+            }
+        } else if (strcmp(key, "matches") == 0) {
+            if (!serve_long(value, 1, 1000000000L, &matches)) bad = "MATCHES MUST BE 1 TO 1000000000";
+        } else if (strcmp(key, "bat") == 0) {
+            if (!serve_long(value, 1, 2, &bat)) bad = "BAT MUST BE 1 OR 2";
+        } else if (strcmp(key, "innings") == 0) {
+            if (!serve_long(value, 1, 2, &innings)) bad = "INNINGS MUST BE 1 OR 2";
+        } else if (strcmp(key, "runs") == 0) {
+            if (!serve_long(value, 0, 6 * 6 * SERVE_MAX_OVERS, &runs)) bad = "BAD RUNS";
+        } else if (strcmp(key, "wickets") == 0) {
+            if (!serve_long(value, 0, MAX_PLAYERS, &wickets)) bad = "BAD WICKETS";
+        } else if (strcmp(key, "balls") == 0) {
+            if (!serve_long(value, 0, 6 * SERVE_MAX_OVERS, &balls)) bad = "BAD BALLS";
+        } else if (strcmp(key, "target") == 0) {
+            if (!serve_long(value, 1, 6 * 6 * SERVE_MAX_OVERS + 1, &target)) bad = "BAD TARGET";
+        } else if (strcmp(key, "format") == 0) {
+            format = strcmp(value, "league") == 0 ? "league" : strcmp(value, "groups") == 0 ? "groups" : NULL;
+            if (!format) bad = "FORMAT MUST BE league OR groups";
+        } else if (strcmp(key, "sides") == 0) {
+            if (!serve_long(value, 2, MAX_SIDES, &side_count)) bad = "SIDES MUST BE 2 TO 256";
+        } else if (strcmp(key, "groups") == 0) {
+            if (!serve_long(value, 1, MAX_SIDES, &groups)) bad = "BAD GROUPS";
+        } else if (strcmp(key, "qualify") == 0) {
+            if (!serve_long(value, 0, MAX_SIDES, &qualify)) bad = "BAD QUALIFY";
+        } else if (strcmp(key, "tournaments") == 0) {
+            if (!serve_long(value, 1, 10000000L, &tournaments)) bad = "TOURNAMENTS MUST BE 1 TO 10000000";
+        } else {
+            bad = "UNKNOWN KEY";
+        }
+        if (bad && !error) error = bad;
+    }
+    
+    if (!verb) error = "EMPTY REQUEST";
+    if (error) {
+        serve_send(c, "%s error %s", id, error);
+        return;
+    }
+    if (strcmp(verb, "ping") == 0) {
+        serve_send(c, "%s ok", id);
+        return;
+    }
+    if (strcmp(verb, "simulate") != 0 && strcmp(verb, "winprob") != 0 &&
+        strcmp(verb, "tournament") != 0) {
+        serve_send(c, "%s error UNKNOWN REQUEST", id);
+        return;
+    }
+    if (strcmp(verb, "winprob") != 0 && *queued >= SERVE_MAX_REQUESTS) {
+        serve_send(c, "%s error SERVER BUSY", id);
+        return;
+    }
+    
+    if (strcmp(verb, "tournament") == 0) {
+        ServeRequest* r = (ServeRequest*)calloc(1, sizeof(ServeRequest));
+        Team* sides = (Team*)calloc(MAX_SIDES, sizeof(Team));
+        int count = 0;
+        
+        if (!r || !sides) {
+            free(r);
+            free(sides);
+            serve_send(c, "%s error NOT ENOUGH MEMORY", id);
+            return;
+        }
+        r->kind = SERVE_TOURNAMENT;
+        r->sides = sides;
+        error = serve_rosters(body, NULL, sides, &count);
+        if (!error && count == 0) {
+            for (count = 0; count < side_count; count++) {
+                char name[MAX_NAME_LENGTH];
+                snprintf(name, sizeof(name), "SIDE %d", count + 1);
+                default_roster(&sides[count], name);
+            }
+        }
+        if (!error) error = serve_check_sides(sides, count);
+        if (!error && !format) error = "A TOURNAMENT NEEDS format=league OR format=groups";
+        if (!error) {
+            if (strcmp(format, "league") == 0) groups = 1;
+            if (qualify < 0) qualify = groups == 1 ? 4 : 2;
+            outcome_model_build(&r->model, &cfg);
+            if (!tournament_init(&r->tournament, sides, count, (int)groups, (int)qualify, &cfg,
+                                 &r->model, seed)) {
+                error = "THE SIDES CANNOT BE SPLIT INTO THAT FORMAT";
+            }
+        }
+        if (!error) {
+            r->works = tournament_work_alloc(&r->tournament, pool->thread_count);
+            if (!r->works) error = "NOT ENOUGH MEMORY";
+        }
+        if (error) {
+            serve_send(c, "%s error %s", id, error);
+            serve_request_free(r, pool->thread_count);
+            return;
+        }
+        r->client = c;
+        snprintf(r->id, sizeof(r->id), "%s", id);
+        r->seed = seed;
+        r->total = tournaments;
+        r->start = now_seconds();
+        r->reported = r->start;
+        queue[(*queued)++] = r;
+        return;
+    }
+    
+    Team squads[MAX_TEAMS];
+    default_roster(&squads[0], "OMOR EKUSHEY HALL");
+    default_roster(&squads[1], "SHAHID SMRITY HALL");
+    error = serve_rosters(body, squads, NULL, NULL);
+    if (!error) error = serve_check_sides(squads, MAX_TEAMS);
+    if (error) {
+        serve_send(c, "%s error %s", id, error);
+        return;
+    }
+    
+    if (strcmp(verb, "winprob") == 0) {
+        MatchState m;
+        float win[MAX_TEAMS], tie;
+        
+        const OutcomeModel* model = serve_winprob_model(&cfg);
+        if (!model) {
+            serve_send(c, "%s error NOT ENOUGH MEMORY", id);
+            return;
+        }
+        match_init_model(&m, squads, &cfg, model);
+        Team* batting = &m.teams[bat - 1];
+        if (balls > cfg.max_overs * 6 || wickets >= batting->player_count || runs > 6 * balls ||
+            (innings == 2 && (target < 1 || runs >= target))) {
+            serve_send(c, "%s error NOT A LIVE MATCH STATE", id);
+            return;
+        }
+        m.currently_batting = (int)bat - 1;
+        m.first_innings = innings == 1;
+        batting->total_runs = (int)runs;
+        batting->total_wickets = (int)wickets;
+        batting->total_balls = (int)balls;
+        if (innings == 2) m.teams[2 - bat].total_runs = (int)target - 1;
+        
+        double start = now_seconds();
+        const WinProbTable* table = serve_winprob_table(&m);
+        if (!table) {
+            serve_send(c, "%s error NOT ENOUGH MEMORY", id);
+            return;
+        }
+        winprob_query(table, &m, win, &tie);
+        serve_send(c, "%s ok team1=%.4f team2=%.4f tie=%.4f ms=%.1f", id, win[0], win[1], tie,
+                   (now_seconds() - start) * 1e3);
+        return;
+    }
+    
+    if (matches == 0) {
+        serve_send(c, "%s error SIMULATE NEEDS matches=N", id);
+        return;
+    }
+    ServeRequest* r = (ServeRequest*)calloc(1, sizeof(ServeRequest));
+    if (!r) {
+        serve_send(c, "%s error NOT ENOUGH MEMORY", id);
+        return;
+    }
+    r->client = c;
+    snprintf(r->id, sizeof(r->id), "%s", id);
+    r->kind = SERVE_SIMULATE;
+    outcome_model_build(&r->model, &cfg);
+    match_init_model(&r->base, squads, &cfg, &r->model);
+    r->kernel = kernel == KERNEL_LOCKSTEP && match_is_uniform(&r->base) ? KERNEL_LOCKSTEP : KERNEL_SCALAR;
+    r->seed = seed;
+    r->total = matches;
+    r->start = now_seconds();
+    r->reported = r->start;
+    queue[(*queued)++] = r;
+}
+
+/* Streams progress, or the final result once every match or tournament
+   of the request has been played. */
+static void serve_report(ServeRequest* r, int workers) {
+    ServeClient* c = r->client;
+    int final = r->done == r->total;
+    double ms = (now_seconds() - r->start) * 1e3;
+    
+    if (r->kind == SERVE_SIMULATE) {
+        const BatchStats* s = &r->stats;
+        double n = s->matches > 0 ? (double)s->matches : 1.0;
+        serve_send(c, "%s %s matches=%ld team1_wins=%ld team2_wins=%ld ties=%ld "
+                   "team1_avg=%.2f team2_avg=%.2f team1_wickets=%.2f team2_wickets=%.2f "
+                   "bat_first_pct=%.2f boundary_pct=%.2f balls=%lld seed=%llu ms=%.1f",
+                   r->id, final ? "ok" : "partial", s->matches, s->wins[0], s->wins[1], s->ties,
+                   s->runs[0] / n, s->runs[1] / n, s->wickets[0] / n, s->wickets[1] / n,
+                   100.0 * s->bat_first_wins / n,
+                   s->balls > 0 ? 100.0 * s->boundaries / s->balls : 0.0,
+                   s->balls, (unsigned long long)r->seed, ms);
+        return;
+    }
+    
+    if (!final) {
+        serve_send(c, "%s partial tournaments=%ld ms=%.1f", r->id, r->done, ms);
+        return;
+    }
+    
+    const Tournament* t = &r->tournament;
+    const TournamentWork* total = &r->works[0];
+    SideOdds order[MAX_SIDES];
+    double runs = (double)r->total;
+    
+    tournament_totals(t, r->works, workers, order);
+    for (int i = 0; i < t->side_count; i++) {
+        int s = order[i].side;
+        if (t->qualifiers > 0) {
+            serve_send(c, "%s side qualify=%.2f final=%.2f title=%.2f points=%.2f name=%s", r->id,
+                       100.0 * total->qualified[s] / runs, 100.0 * total->finals[s] / runs,
+                       100.0 * total->titles[s] / runs, total->points[s] / runs, t->sides[s].name);
+        } else {
+            serve_send(c, "%s side qualify=- final=- title=%.2f points=%.2f name=%s", r->id,
+                       100.0 * total->titles[s] / runs, total->points[s] / runs, t->sides[s].name);
+        }
+    }
+    serve_send(c, "%s ok tournaments=%ld matches=%lld seed=%llu ms=%.1f", r->id, r->total,
+               (long long)r->total * t->streams, (unsigned long long)r->seed, ms);
+}
+
+/* One round: the queued simulations split SERVE_ROUND matches evenly and
+   run as a single pool job, then each queued tournament plays a slice of
+   about the same number of matches. Small requests finish in their first
+   round while large ones carry on across rounds. */
+static void serve_round(ThreadPool* pool, ServeJob* job, ServeRequest** queue, int queued) {
+    int simulations = 0;
+    long items = 0;
+    
+    for (int i = 0; i < queued; i++) simulations += queue[i]->kind == SERVE_SIMULATE;
+    
+    job->segment_count = 0;
+    for (int i = 0; i < queued && simulations > 0; i++) {
+        ServeRequest* r = queue[i];
+        if (r->kind != SERVE_SIMULATE) continue;
+        
+        ServeSegment* seg = &job->segments[job->segment_count++];
+        long count = r->total - r->done;
+        if (count > SERVE_ROUND / simulations) count = SERVE_ROUND / simulations;
+        seg->request = r;
+        seg->offset = items;
+        seg->count = count;
+        items += count;
+    }
+    if (items > 0) {
+        long chunk = items / (pool->thread_count * 64L);
+        if (chunk < 256) chunk = 256;
+        pool_run(pool, serve_task, job, items, chunk);
+        for (int i = 0; i < job->segment_count; i++) {
+            job->segments[i].request->done += job->segments[i].count;
+        }
+    }
+    
+    for (int i = 0; i < queued; i++) {
+        ServeRequest* r = queue[i];
+        if (r->kind != SERVE_TOURNAMENT) continue;
+        
+        TournamentJob tj;
+        long slice = SERVE_ROUND / queued / r->tournament.streams;
+        if (slice < 1) slice = 1;
+        if (slice > r->total - r->done) slice = r->total - r->done;
+        tj.t = &r->tournament;
+        tj.works = r->works;
+        tj.first = r->done;
+        pool_run(pool, tournament_task, &tj, slice, 1);
+        r->done += slice;
+    }
+}
+
+/* Reads what the client has sent and handles every request completed by a
+   blank line. */
+static void serve_read(ServeClient* c, ServeRequest** queue, int* queued, ThreadPool* pool,
+                       uint64_t seed, uint64_t* serial, BatchKernel kernel) {
+    ssize_t n = read(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len);
+    if (n < 0 && errno == EINTR) return;
+    if (n == 0) {
+        c->finished = 1;
+        return;
+    }
+    if (n < 0) {
+        c->failed = 1;
+        return;
+    }
+    c->in_len += (size_t)n;
+    
+    for (;;) {
+        size_t line = 0, next = 0;
+        for (size_t i = 0; i < c->in_len; i++) {
+            if (c->in[i] != '\n') continue;
+            if (i == line || (i == line + 1 && c->in[line] == '\r')) {
+                next = i + 1;
+                break;
+            }
+            line = i + 1;
+        }
+        if (next == 0) break;
+        
+        if (line > 0) {
+            c->in[line] = '\0';
+            serve_request(c, c->in, queue, queued, pool, seed + (*serial)++, kernel);
+        }
+        c->in_len -= next;
+        memmove(c->in, c->in + next, c->in_len);
+    }
+    if (c->in_len == sizeof(c->in)) {
+        serve_send(c, "- error REQUEST TOO LARGE");
+        c->failed = 1;
+    }
+}
+
+/* Opens the listening socket. A socket left behind by a server that has
+   gone is replaced; a live one, or any other file, is not. */
+static int serve_listen(const char* path) {
+    struct sockaddr_un addr;
+    struct stat st;
+    
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "SOCKET PATH TOO LONG: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+    
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "%s EXISTS AND IS NOT A SOCKET\n", path);
+            return -1;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        int live = probe >= 0 && connect(probe, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        if (probe >= 0) close(probe);
+        if (live) {
+            fprintf(stderr, "%s IS IN USE\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        fprintf(stderr, "CANNOT LISTEN ON %s\n", path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Local simulation server: clients connect to the Unix socket at `path`
+   and send requests, which are coalesced into rounds on one thread pool.
+   The CLI's --overs, --wicket-prob, --run-weights and --kernel become the
+   defaults for every request; requests without a seed= get --seed plus
+   the number of requests seen so far. */
+int run_serve(const char* path, int threads, uint64_t seed, BatchKernel kernel) {
+    ServeClient* clients[SERVE_MAX_CLIENTS];
+    ServeRequest* queue[SERVE_MAX_REQUESTS];
+    struct pollfd fds[SERVE_MAX_CLIENTS + 1];
+    int client_count = 0, queued = 0;
+    uint64_t serial = 0;
+    
+    int listener = serve_listen(path);
+    if (listener < 0) return 1;
+    
+    ThreadPool* pool = pool_create(threads);
+    ServeJob* job = (ServeJob*)calloc(1, sizeof(ServeJob));
+    if (pool) job->states = (MatchState*)malloc(pool->thread_count * sizeof(MatchState));
+    if (!pool || !job || !job->states) {
+        fprintf(stderr, "CANNOT START THREAD POOL\n");
+        if (job) free(job->states);
+        free(job);
+        if (pool) pool_destroy(pool);
+        close(listener);
+        unlink(path);
+        return 1;
+    }
+    mutex_init(&job->lock);
+    
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, serve_signal);
+    signal(SIGTERM, serve_signal);
+    printf(GREEN "SERVING ON %s WITH %d THREADS\n" RESET, path, pool->thread_count);
+    fflush(stdout);
+    
+    while (!serve_stop) {
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < client_count; i++) {
+            fds[i + 1].fd = clients[i]->fd;
+            fds[i + 1].events = clients[i]->finished ? 0 : POLLIN;
+        }
+        
+        int ready = poll(fds, (nfds_t)client_count + 1, queued > 0 ? 0 : -1);
+        stats_poll();
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "POLL FAILED\n");
+            break;
+        }
+        
+        for (int i = 0; i < client_count; i++) {
+            if (!clients[i]->finished && (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+                serve_read(clients[i], queue, &queued, pool, seed, &serial, kernel);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0 && client_count < SERVE_MAX_CLIENTS &&
+                (clients[client_count] = (ServeClient*)calloc(1, sizeof(ServeClient))) != NULL) {
+                clients[client_count++]->fd = fd;
+            } else if (fd >= 0) {
+                static const char full[] = "- error TOO MANY CLIENTS\n";
+                send(fd, full, sizeof(full) - 1, 0);
+                close(fd);
+            }
+        }
+        
+        if (queued > 0) {
+            serve_round(pool, job, queue, queued);
+            
+            double now = now_seconds();
+            int kept = 0;
+            for (int i = 0; i < queued; i++) {
+                ServeRequest* r = queue[i];
+                if (r->done == r->total) {
+                    serve_report(r, pool->thread_count);
+                    serve_request_free(r, pool->thread_count);
+                    continue;
+                }
+                if (now - r->reported >= SERVE_PARTIAL) {
+                    serve_report(r, pool->thread_count);
+                    r->reported = now;
+                }
+                queue[kept++] = r;
+            }
+            queued = kept;
+        }
+        
+        /* A client that has gone takes its unfinished requests with it; one
+           that has only finished sending is closed once it has its answers. */
+        int kept = 0;
+        for (int i = 0; i < client_count; i++) {
+            ServeClient* c = clients[i];
+            int waiting = 0;
+            for (int q = 0; q < queued; q++) waiting += queue[q]->client == c;
+            if (!c->failed && (!c->finished || waiting > 0)) {
+                clients[kept++] = c;
+                continue;
+            }
+            int left = 0;
+            for (int q = 0; q < queued; q++) {
+                if (queue[q]->client == c) {
+                    serve_request_free(queue[q], pool->thread_count);
+                } else {
+                    queue[left++] = queue[q];
+                }
+            }
+            queued = left;
+            close(c->fd);
+            free(c);
+        }
+        client_count = kept;
+    }
+    
+    for (int q = 0; q < queued; q++) serve_request_free(queue[q], pool->thread_count);
+    for (int i = 0; i < client_count; i++) {
+        close(clients[i]->fd);
+        free(clients[i]);
+    }
+    close(listener);
+    unlink(path);
+    mutex_destroy(&job->lock);
+    free(job->states);
+    free(job);
+    pool_destroy(pool);
+    printf(YELLOW "SERVER STOPPED\n" RESET);
+    return 0;
+}
+#else
+int run_serve(const char* path, int threads, uint64_t seed, BatchKernel kernel) {
+    (void)path;
+    (void)threads;
+    (void)seed;
+    (void)kernel;
+    fprintf(stderr, "--serve NEEDS UNIX DOMAIN SOCKETS, WHICH THIS BUILD DOES NOT HAVE\n");
+    return 1;
+}
+#endif
+
+int run_command_line(int argc, char** argv) {
+    long matches = 0;
+    int threads = cpu_count();
+    int scaling = 0;
+    int winprob_check = 0;
+    int calibrate = 0;
+    const char* xi_pool = NULL;
+    const char* xi_path = NULL;
+    int candidates = SELECTION_CANDIDATES;
+    double target[CALIBRATION_TARGETS] = {-1.0, -1.0, -1.0, -1.0};
+    uint64_t seed = (uint64_t)time(NULL);
+    int seed_given = 0;
+    long replay = -1;
+    int at_ball = -1;
+    const char* checkpoint_path = NULL;
+    const char* resume_path = NULL;
+    const char* serve_path = NULL;
+    int pause_at = 60;
+    int stats_at_end = 0;
+    BatchKernel kernel = KERNEL_SCALAR;
+    const char* roster_path[MAX_TEAMS] = {NULL, NULL};
+    const char* log_path = NULL;
+    const char* scan_path = NULL;
+    const char* query = NULL;
+    const char* query_team = NULL;
+    int top = 10;
+    const char* format = NULL;
+    const char* roster_list = NULL;
+    int side_count = 32;
+    int groups = 4;
+    int qualify = -1;
+    long runs = 1;
+    double ci = 0.0;
+    int antithetic = 0;
+    const char* compare_path = NULL;
+    float compare_wicket = -1.0f;
+    float compare_weights[7] = {-1.0f};
+    
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (strcmp(arg, "--scaling") == 0) {
+            scaling = 1;
+            continue;
+        }
+        if (strcmp(arg, "--winprob-check") == 0) {
+            winprob_check = 1;
+            continue;
+        }
+        if (strcmp(arg, "--calibrate") == 0) {
+            calibrate = 1;
+            continue;
+        }
+        if (strcmp(arg, "--antithetic") == 0) {
+            antithetic = 1;
+            continue;
+        }
+        if (value == NULL) {
+            fprintf(stderr, "UNKNOWN OR INCOMPLETE OPTION: %s\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        
+        if (strcmp(arg, "--batch") == 0) {
+            matches = atol(value);
+        } else if (strcmp(arg, "--team1") == 0) {
+            roster_path[0] = value;
+        } else if (strcmp(arg, "--team2") == 0) {
+            roster_path[1] = value;
+        } else if (strcmp(arg, "--overs") == 0) {
+            config.max_overs = atoi(value);
+        } else if (strcmp(arg, "--wicket-prob") == 0) {
+            config.wicket_probability = (float)atof(value);
+        } else if (strcmp(arg, "--run-weights") == 0) {
+            if (!parse_run_weights(value, config.run_weights)) {
+                fprintf(stderr, "RUN WEIGHTS MUST BE 7 NON-NEGATIVE NUMBERS, NOT ALL ZERO: %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--ci") == 0) {
+            ci = atof(value);
+            if (ci <= 0.0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--compare") == 0) {
+            compare_path = value;
+        } else if (strcmp(arg, "--compare-wicket-prob") == 0) {
+            compare_wicket = (float)atof(value);
+            if (compare_wicket < 0.0f || compare_wicket > 1.0f) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--compare-run-weights") == 0) {
+            if (!parse_run_weights(value, compare_weights)) {
+                fprintf(stderr, "RUN WEIGHTS MUST BE 7 NON-NEGATIVE NUMBERS, NOT ALL ZERO: %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--best-xi") == 0) {
+            xi_pool = value;
+        } else if (strcmp(arg, "--candidates") == 0) {
+            candidates = atoi(value);
+        } else if (strcmp(arg, "--xi-file") == 0) {
+            xi_path = value;
+        } else if (strcmp(arg, "--target-score") == 0) {
+            target[0] = atof(value);
+        } else if (strcmp(arg, "--target-wickets") == 0) {
+            target[1] = atof(value);
+        } else if (strcmp(arg, "--target-boundaries") == 0) {
+            target[2] = atof(value);
+        } else if (strcmp(arg, "--target-ties") == 0) {
+            target[3] = atof(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            threads = atoi(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            seed = strtoull(value, NULL, 10);
+            seed_given = 1;
+        } else if (strcmp(arg, "--replay") == 0) {
+            replay = atol(value);
+        } else if (strcmp(arg, "--ball") == 0) {
+            at_ball = atoi(value);
+        } else if (strcmp(arg, "--checkpoint") == 0) {
+            checkpoint_path = value;
+        } else if (strcmp(arg, "--pause-at") == 0) {
+            pause_at = atoi(value);
+        } else if (strcmp(arg, "--resume") == 0) {
+            resume_path = value;
+        } else if (strcmp(arg, "--serve") == 0) {
+            serve_path = value;
+        } else if (strcmp(arg, "--log") == 0) {
+            log_path = value;
+        } else if (strcmp(arg, "--sync-every") == 0) {
+            log_sync_matches = atoi(value);
+        } else if (strcmp(arg, "--sync-ms") == 0) {
+            log_sync_ms = atoi(value);
+        } else if (strcmp(arg, "--scan") == 0) {
+            scan_path = value;
+        } else if (strcmp(arg, "--query") == 0) {
+            query = value;
+        } else if (strcmp(arg, "--team") == 0) {
+            query_team = value;
+        } else if (strcmp(arg, "--top") == 0) {
+            top = atoi(value);
+        } else if (strcmp(arg, "--tournament") == 0) {
+            format = value;
+        } else if (strcmp(arg, "--sides") == 0) {
+            side_count = atoi(value);
+        } else if (strcmp(arg, "--rosters") == 0) {
+            roster_list = value;
+        } else if (strcmp(arg, "--groups") == 0) {
+            groups = atoi(value);
+        } else if (strcmp(arg, "--qualify") == 0) {
+            qualify = atoi(value);
+        } else if (strcmp(arg, "--runs") == 0) {
+            runs = atol(value);
+        } else if (strcmp(arg, "--kernel") == 0) {
+            if (strcmp(value, "scalar") == 0) {
+                kernel = KERNEL_SCALAR;
+            } else if (strcmp(value, "lockstep") == 0) {
+                kernel = KERNEL_LOCKSTEP;
+            } else {
+                fprintf(stderr, "UNKNOWN KERNEL: %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--stats") == 0) {
+            if (strcmp(value, "text") != 0 && strcmp(value, "json") != 0) {
+                fprintf(stderr, "UNKNOWN STATS FORMAT: %s\n", value);
+                return 1;
+            }
+            stats_json = strcmp(value, "json") == 0;
+            stats_at_end = 1;
+        } else {
+            fprintf(stderr, "UNKNOWN OPTION: %s\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    
+    if (stats_at_end) atexit(stats_at_exit);
+    if (scan_path) {
+        return run_log_scan(scan_path);
+    }
+    if (query) {
+        return run_history_query(log_path ? log_path : "history", query, query_team, top);
+    }
+    if (resume_path) {
+        if (threads < 1) threads = 1;
+        if (threads > MAX_THREADS) threads = MAX_THREADS;
+        ThreadPool* pool = pool_create(threads);
+        if (!pool) {
+            fprintf(stderr, "CANNOT START THREAD POOL\n");
+            return 1;
+        }
+        int status = run_resume(pool, resume_path);
+        pool_destroy(pool);
+        return status;
+    }
+    if (serve_path) {
+        if (config.max_overs < 1 || config.max_overs > SERVE_MAX_OVERS ||
+            config.wicket_probability < 0.0f || config.wicket_probability > 1.0f) {
+            fprintf(stderr, "OVERS MUST BE 1 TO %d AND THE WICKET PROBABILITY IN [0, 1]\n", SERVE_MAX_OVERS);
+            return 1;
+        }
+        if (threads < 1) threads = 1;
+        if (threads > MAX_THREADS) threads = MAX_THREADS;
+        return run_serve(serve_path, threads, seed, kernel);
+    }
+    if (replay >= 0 && (log_path || !seed_given)) {
+        return run_replay(log_path ? log_path : "history", (uint32_t)replay, NULL, 0, 0, at_ball);
+    }
+    if (format) {
+        return run_tournament_command(format, roster_list, side_count, groups, qualify,
+                                      runs, seed, threads);
+    }
+    
+    if (xi_pool) {
+        Team opponent;
+        if (roster_path[1] == NULL) {
+            default_roster(&opponent, "SHAHID SMRITY HALL");
+        } else if (!load_roster(roster_path[1], &opponent)) {
+            fprintf(stderr, "CANNOT READ ROSTER: %s\n", roster_path[1]);
+            return 1;
+        }
+        if (opponent.player_count < 2 || count_bowlers(&opponent) < 2) {
+            fprintf(stderr, "%s NEEDS AT LEAST 2 PLAYERS AND 2 BOWLERS\n", opponent.name);
+            return 1;
+        }
+        if (candidates < 1 || matches < 0 || threads < 1 || config.max_overs <= 0) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (threads > MAX_THREADS) threads = MAX_THREADS;
+        return run_best_xi(xi_pool, &opponent, candidates,
+                           matches > 0 ? matches : SELECTION_FIRST_ROUND, seed, threads, xi_path);
+    }
+    
+    if (calibrate) {
+        int targets = 0;
+        for (int k = 0; k < CALIBRATION_TARGETS; k++) targets += target[k] >= 0;
+        if (targets == 0) {
+            fprintf(stderr, "CALIBRATION NEEDS AT LEAST ONE --target-* OPTION\n");
+            return 1;
+        }
+        if (matches == 0) matches = CALIBRATION_MATCHES;
+    }
+    
+    int comparing = compare_path || compare_wicket >= 0.0f || compare_weights[0] >= 0.0f;
+    int estimate = ci > 0 || antithetic || comparing;
+    if (estimate) {
+        if (checkpoint_path || log_path || winprob_check || calibrate || scaling || replay >= 0) {
+            fprintf(stderr, "--ci, --antithetic AND --compare ONLY WORK ON A PLAIN --batch\n");
+            return 1;
+        }
+        if (matches == 0) matches = ESTIMATE_MAX_MATCHES;
+    }
+    
+    if (matches == 0 && !scaling && replay < 0) {
+        rng_seed(&game_rng, seed);
+        game_threads = threads;
+        run_interactive();
+        return 0;
+    }
+    
+    if ((matches <= 0 && replay < 0) || config.max_overs <= 0 || threads < 1 || pause_at < 0 ||
+        log_sync_matches < 0 || log_sync_ms < 0 ||
+        config.wicket_probability < 0.0f || config.wicket_probability > 1.0f) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    
+    const char* default_names[MAX_TEAMS] = {"OMOR EKUSHEY HALL", "SHAHID SMRITY HALL"};
+    for (int t = 0; t < MAX_TEAMS; t++) {
+        if (roster_path[t] == NULL) {
+            default_roster(&teams[t], default_names[t]);
+        } else if (!load_roster(roster_path[t], &teams[t])) {
+            fprintf(stderr, "CANNOT READ ROSTER: %s\n", roster_path[t]);
+            return 1;
+        }
+        if (teams[t].player_count < 2 || count_bowlers(&teams[t]) < 2) {
+            fprintf(stderr, "%s NEEDS AT LEAST 2 PLAYERS AND 2 BOWLERS\n", teams[t].name);
+            return 1;
+        }
+    }
+    
+    match_init(&match, teams, &config);
+    
+    /* The compared setup keeps team 2 and the options given for the base,
+       with team 1's roster and the model swapped for the --compare ones. */
+    MatchState alt;
+    if (comparing) {
+        GameConfig compare = config;
+        Team squads[MAX_TEAMS] = {teams[0], teams[1]};
+        if (compare_path && !load_roster(compare_path, &squads[0])) {
+            fprintf(stderr, "CANNOT READ ROSTER: %s\n", compare_path);
+            return 1;
+        }
+        if (squads[0].player_count < 2 || count_bowlers(&squads[0]) < 2) {
+            fprintf(stderr, "%s NEEDS AT LEAST 2 PLAYERS AND 2 BOWLERS\n", squads[0].name);
+            return 1;
+        }
+        if (compare_wicket >= 0.0f) compare.wicket_probability = compare_wicket;
+        if (compare_weights[0] >= 0.0f) memcpy(compare.run_weights, compare_weights, sizeof(compare_weights));
+        match_init(&alt, squads, &compare);
+    }
+    
+    if (replay >= 0) {
+        return run_replay(NULL, 0, &match, replay, seed, at_ball);
+    }
+    if (scaling) {
+        run_scaling_report(&match, matches, seed, kernel, threads);
+        return 0;
+    }
+    
+    ThreadPool* pool = pool_create(threads);
+    if (!pool) {
+        fprintf(stderr, "CANNOT START THREAD POOL\n");
+        return 1;
+    }
+    
+    if (estimate) {
+        int status = run_estimate(pool, &match, comparing ? &alt : NULL,
+                                  matches, seed, ci, antithetic);
+        pool_destroy(pool);
+        return status;
+    }
+    if (winprob_check) {
+        int status = run_winprob_check(pool, &match, matches, seed, kernel);
+        pool_destroy(pool);
+        return status;
+    }
+    if (calibrate) {
+        int status = run_calibration(pool, &match, matches, seed, target);
+        pool_destroy(pool);
+        return status;
+    }
+    if (checkpoint_path) {
+        int status = run_checkpoint(pool, &match, matches, seed, pause_at, checkpoint_path);
+        pool_destroy(pool);
+        return status;
+    }
+    
+    /* The lockstep kernel keeps only team totals, so logging balls needs
+       the per-ball engine. */
+    EventLog log;
+    if (log_path) {
+        if (!event_log_open(&log, log_path)) {
+            fprintf(stderr, "CANNOT OPEN EVENT LOG: %s\n", log_path);
+            pool_destroy(pool);
+            return 1;
+        }
+        kernel = KERNEL_SCALAR;
+    }
+    
+    BatchStats stats;
+    memset(&stats, 0, sizeof(stats));
+    
+    double start = now_seconds();
+    run_parallel_batch(pool, &match, matches, seed, kernel, &stats, log_path ? &log : NULL);
+    double elapsed = now_seconds() - start;
+    
+    int status = 0;
+    if (log_path) {
+        if (__atomic_load_n(&log.failed, __ATOMIC_RELAXED)) {
+            fprintf(stderr, "CANNOT WRITE EVENT LOG: %s\n", log_path);
+            status = 1;
+        }
+        event_log_close(&log);
+    }
+    
+    print_batch_stats(&match, &stats);
+    printf("SEED: %llu\n", (unsigned long long)seed);
+    printf("THREADS: %d  BALLS: %lld  TIME: %.3fs  MATCHES/SEC: %.0f  BALLS/SEC: %.0f\n",
+           pool->thread_count, stats.balls, elapsed,
+           elapsed > 0 ? stats.matches / elapsed : 0.0,
+           elapsed > 0 ? stats.balls / elapsed : 0.0);
+    
+    pool_destroy(pool);
+    return status;
 }